@@ -0,0 +1,223 @@
+#include "include/acceptance.h"
+#include "include/geometry.h"
+#include "include/kinematics.h"
+#include "include/lattice.h"
+#include "include/tracking.h"
+#include "include/tqdm.h"
+#include "include/utils.h"
+
+#include <iostream>
+#include <memory_resource>
+#include <vector>
+#include <boost/program_options.hpp>
+
+#include "Math/Vector3D.h" // XYZVector
+
+struct InputArgs {
+public:
+  tracking::TrackMode mode;
+  float zcutoff;
+  float Bscale;
+  float xmin;
+  float xmax;
+  float ymin;
+  float ymax;
+  unsigned grid;
+  unsigned nbins;
+  float slope_max;
+  unsigned nslopes;
+  float pmin;
+  float pmax;
+  unsigned np;
+  float mass;
+  int charge;
+  unsigned margin;
+  std::string output;
+};
+
+//values of 'n' points over [lo, hi] (the single value 'lo' for n == 1)
+Vec<double> points(double lo, double hi, unsigned n) {
+  Vec<double> v(n);
+  for(unsigned k=0; k<n; ++k)
+    v[k] = n == 1 ? lo : lo + k*(hi - lo)/(n - 1);
+  return v;
+}
+
+//axis with one bin centred on each of the 'n' points over [lo, hi]
+AcceptanceMap::Axis point_axis(double lo, double hi, unsigned n) {
+  const double d = n == 1 ? std::max(1e-9, 1e-9*std::abs(lo)) : (hi - lo) / (n - 1);
+  return AcceptanceMap::Axis{n, lo - d/2, lo + (n - 0.5)*d};
+}
+
+void run(const InputArgs& args)
+{
+  /*
+    Tracks particles forward from a grid over the plane where v1_beam starts the spectators
+    moving towards the calorimeters (z = -side*(zcutoff+50)), with the tracking of v1_beam
+    ('mode', 'zcutoff', field scale and step settings), and extrapolates their last state
+    along a straight line into the calorimeter boxes, as the analysis of v1_beam does.
+    The grid spans the position, the slopes and the momentum: the map is keyed on the
+    same initial state that v1_beam looks up before tracking.
+  */
+  MagnetSystem magnets(magnet_lattice());
+  const CaloSystem calos(zdc_calos());
+
+  //all the calorimeters must be on the same side of the interaction point
+  const Calo& first = calos.calos().front();
+  const int side = first.dims.Z().first < 0 ? -1 : 1;
+  for(const Calo& c : calos.calos())
+    if((c.dims.Z().first < 0 ? -1 : 1) != side or c.dims.Z().first * c.dims.Z().second <= 0)
+      throw std::invalid_argument("The calorimeters must be on one side of the interaction point.");
+
+  const double zstart = -side * (args.zcutoff + 50.); //cm, as in v1_beam
+  const tracking::StepSettings steps = tracking::step_settings(args.mode, args.zcutoff);
+  const Vec<double> moms = points(args.pmin, args.pmax, args.np);
+  const Vec<double> slopes = points(-args.slope_max, args.slope_max, args.nslopes);
+
+  Vec<std::string> labels;
+  for(const Calo& c : calos.calos())
+    labels.push_back(c.label);
+  AcceptanceMap map({{ AcceptanceMap::Axis{args.nbins, args.xmin, args.xmax},
+		       AcceptanceMap::Axis{args.nbins, args.ymin, args.ymax},
+		       point_axis(slopes.front(), slopes.back(), args.nslopes),
+		       point_axis(slopes.front(), slopes.back(), args.nslopes),
+		       point_axis(args.pmin, args.pmax, args.np) }},
+		    side, AcceptanceMap::Tracking{args.mode, args.zcutoff, args.Bscale}, labels);
+
+  //initial states and last positions and momenta of one row of the grid
+  const std::size_t nrow = args.grid * slopes.size() * slopes.size() * moms.size();
+  std::pmr::memory_resource* mem = std::pmr::get_default_resource();
+  kinematics::ThreeVectors last(nrow, mem), lastMom(nrow, mem), hit(nrow, mem);
+  Vec<unsigned char> accepted(nrow);
+  Vec<AcceptanceMap::State> states(nrow);
+  unsigned long nreached = 0;
+
+  std::cout << "Tracking from z=" << zstart << " cm" << std::endl;
+  for(unsigned i : tq::trange(args.grid)) {
+    const double x = args.xmin + (i + 0.5) * (args.xmax - args.xmin) / args.grid;
+    std::size_t k = 0;
+    for(unsigned j=0; j<args.grid; ++j) {
+      const double y = args.ymin + (j + 0.5) * (args.ymax - args.ymin) / args.grid;
+      for(double xp : slopes)
+	for(double yp : slopes)
+	  for(double p : moms) {
+	    Particle part;
+	    const double pz = side * p / std::sqrt(1. + xp*xp + yp*yp);
+	    part.pos = XYZ(x, y, zstart);
+	    part.mom = XYZ(xp*pz, yp*pz, pz);
+	    part.mass = args.mass;
+	    part.energy = std::sqrt(p*p + args.mass*args.mass);
+	    part.charge = args.charge;
+
+	    SimParticle simp(part, steps.nsteps, steps.stepsize);
+	    const TrackSummary s = simp.summarize(magnets, args.mode, args.Bscale, args.zcutoff);
+	    last.set(k, s.lastPos);
+	    lastMom.set(k, s.lastMom);
+	    states[k] = AcceptanceMap::State{{x, y, xp, yp, p}};
+	    ++k;
+	  }
+    }
+
+    for(unsigned ic=0; ic<calos.size(); ++ic) {
+      calos.hits(ic, last, lastMom, hit, accepted.data());
+      for(std::size_t n=0; n<nrow; ++n)
+	if(accepted[n]) {
+	  map.mark(states[n], ic);
+	  ++nreached;
+	}
+    }
+  }
+  std::cerr << std::endl;
+
+  map.dilate(args.margin);
+  map.write(args.output);
+
+  std::cout << " --- Acceptance Map --- " << std::endl;
+  std::cout << "Calorimeter hits: " << nreached << " / " << nrow * args.grid << " tracks" << std::endl;
+  std::cout << "x range: [" << map.axes()[0].lo << ", " << map.axes()[0].hi << "[" << std::endl;
+  std::cout << "y range: [" << map.axes()[1].lo << ", " << map.axes()[1].hi << "[" << std::endl;
+  std::cout << "Occupancy: " << map.occupancy() << std::endl;
+  std::cout << "Written to " << args.output << std::endl;
+  std::cout << "--------------------------" << std::endl;
+}
+
+// run example: ./acceptance_map.exe --mode euler --zcutoff 5000 --pmin 1300 --pmax 1400 --np 11 --output data/acceptance_zdc.bin
+int main(int argc, char **argv) {
+  namespace po = boost::program_options;
+  po::options_description desc("Options");
+  desc.add_options()
+    ("help,h", "produce this help message")
+    ("mode", po::value<std::string>()->default_value("euler"), "numerical solver of the v1_beam runs (euler or rk4)")
+    ("zcutoff", po::value<float>()->default_value(5000.f), "'--zcutoff' of the v1_beam runs")
+    ("Bscale", po::value<float>()->default_value(1.f), "'--Bscale' of the v1_beam runs")
+    ("xmin", po::value<float>()->default_value(-2.f), "lowest initial x [cm]")
+    ("xmax", po::value<float>()->default_value(2.f), "highest initial x [cm]")
+    ("ymin", po::value<float>()->default_value(-2.f), "lowest initial y [cm]")
+    ("ymax", po::value<float>()->default_value(2.f), "highest initial y [cm]")
+    ("grid", po::value<unsigned>()->default_value(50), "number of starting points along x and y")
+    ("nbins", po::value<unsigned>()->default_value(50), "number of bins of the map along x and y (not finer than the grid)")
+    ("slope_max", po::value<float>()->default_value(0.f), "largest initial slope |px/pz| and |py/pz| (v1_beam starts the particles along z)")
+    ("nslopes", po::value<unsigned>()->default_value(1), "number of initial slopes along x' and y' (bins of the map)")
+    ("pmin", po::value<float>()->required(), "lowest momentum [GeV/c]")
+    ("pmax", po::value<float>()->required(), "highest momentum [GeV/c]")
+    ("np", po::value<unsigned>()->default_value(11), "number of momenta (bins of the map along p)")
+    ("charge", po::value<int>()->default_value(1), "charge of the particles")
+    ("margin", po::value<unsigned>()->default_value(1), "number of cells added around the accepted region")
+    ("output", po::value<std::string>()->default_value("data/acceptance.bin"), "name of the acceptance map file");
+
+  po::variables_map vm;
+  po::store(po::parse_command_line(argc,argv,desc), vm);
+  po::notify(vm);
+
+  if(vm.count("help") or argc<2) {
+    std::cerr << desc << std::endl;
+    std::exit(0);
+  }
+
+  std::cout << "--- Executable options ---" << std::endl;
+  for (const auto& it : vm) {
+    std::cout << it.first.c_str() << ": ";
+    auto& value = it.second.value();
+    if (auto v = boost::any_cast<float>(&value))
+      std::cout << *v << std::endl;
+    else if (auto v = boost::any_cast<int>(&value))
+      std::cout << *v << std::endl;
+    else if (auto v = boost::any_cast<std::string>(&value))
+      std::cout << *v << std::endl;
+    else if (auto v = boost::any_cast<unsigned>(&value))
+      std::cout << *v << std::endl;
+    else
+      std::cerr << "type missing" << std::endl;
+  }
+
+  InputArgs info;
+  const std::string mode = boost::any_cast<std::string>(vm["mode"].value());
+  if(mode == "euler") info.mode = tracking::TrackMode::Euler;
+  else if(mode == "rk4") info.mode = tracking::TrackMode::RungeKutta4;
+  else throw std::invalid_argument("This mode is not supported.");
+  info.zcutoff = boost::any_cast<float>(vm["zcutoff"].value());
+  info.Bscale = boost::any_cast<float>(vm["Bscale"].value());
+  info.xmin = boost::any_cast<float>(vm["xmin"].value());
+  info.xmax = boost::any_cast<float>(vm["xmax"].value());
+  info.ymin = boost::any_cast<float>(vm["ymin"].value());
+  info.ymax = boost::any_cast<float>(vm["ymax"].value());
+  info.grid = boost::any_cast<unsigned>(vm["grid"].value());
+  info.nbins = boost::any_cast<unsigned>(vm["nbins"].value());
+  info.slope_max = boost::any_cast<float>(vm["slope_max"].value());
+  info.nslopes = boost::any_cast<unsigned>(vm["nslopes"].value());
+  info.pmin = boost::any_cast<float>(vm["pmin"].value());
+  info.pmax = boost::any_cast<float>(vm["pmax"].value());
+  info.np = boost::any_cast<unsigned>(vm["np"].value());
+  info.mass = 0.938; //GeV
+  info.charge = boost::any_cast<int>(vm["charge"].value());
+  info.margin = boost::any_cast<unsigned>(vm["margin"].value());
+  info.output = boost::any_cast<std::string>(vm["output"].value());
+  if(info.grid == 0 or info.nbins == 0 or info.np == 0 or info.nslopes == 0 or info.pmax < info.pmin
+     or !(info.xmax > info.xmin) or !(info.ymax > info.ymin) or info.slope_max < 0)
+    throw std::invalid_argument("Invalid grid, binning, position, slope or momentum range.");
+
+  run(info);
+
+  std::cout << std::endl;
+  return 0;
+}
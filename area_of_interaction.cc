@@ -10,6 +10,7 @@
 
 #include "include/tqdm.h"
 #include "include/generator.h"
+#include "include/output.h"
 
 struct InputArgs {
 public:
@@ -85,10 +86,9 @@ void run(const InputArgs& args)
   print_startup_info(args);
   
   //set output-related variables
-  std::fstream file;
   std::string filename("data/area_of_intersection.csv");
-  file.open(filename, std::ios_base::out);
-  file << "Idx,Area0,Area1,Area2,Area3,Area4,Theta" << std::endl;
+  CSVWriter file(filename);
+  file.header({"Idx", "Area0", "Area1", "Area2", "Area3", "Area4", "Theta"});
   
   //set global variables
   double leadR = 6.68; // [fm]
@@ -112,23 +112,14 @@ void run(const InputArgs& args)
       area_v[iter] = area0;
       theta_v[iter] = theta;
       
-      char astr0[40], astr1[40], astr2[40], astr3[40], astr4[40];
-      char theta_str[40];
-      sprintf(astr0, "%.20f", area0);
-      sprintf(astr1, "%.20f", area1);
-      sprintf(astr2, "%.20f", area2);
-      sprintf(astr3, "%.20f", area3);
-      sprintf(astr4, "%.20f", area4);
-      sprintf(theta_str, "%.20f", theta);
-      
-      file << std::to_string( iter ) << ","
-	   << astr0 << ","
-	   << astr1 << ","
-	   << astr2 << ","
-	   << astr3 << ","
-	   << astr4 << ","
-	   << theta_str
-	   << std::endl;
+      file.field( iter )
+	.field( area0, 20 )
+	.field( area1, 20 )
+	.field( area2, 20 )
+	.field( area3, 20 )
+	.field( area4, 20 )
+	.field( theta, 20 )
+	.end_line();
 
     }
   file.close();
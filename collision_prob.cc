@@ -1,6 +1,7 @@
 #include "include/geometry.h"
 #include "include/tracking.h"
 #include "include/generator.h"
+#include "include/output.h"
 #include "include/tqdm.h"
 #include "include/utils.h"
 
@@ -103,7 +104,7 @@ long double solve_order2_distance_intersection(long double z1, long double z2, l
 		 long double vel2 = velocity*velocity;
 		 return 2*(1+std::cos(angle))*vel2;
 	       };
-s
+
   auto bfunc = [z1, z2, y2, velocity, angle]() {
 		 long double zdiff = z1-z2;
 		 return 2*velocity*(zdiff*(1+std::cos(angle))-y2*std::sin(angle));
@@ -130,7 +131,6 @@ void run(const InputArgs& args)
   using XYZ = ROOT::Math::XYZVector;
 
   //set global variables
-  std::fstream file;
   XYZ origin(0., 0., 0.);
 
   long double dist = 1.1;
@@ -159,7 +159,8 @@ void run(const InputArgs& args)
   unsigned batchSize_;
 
   std::string filename("data/collision_prob.csv");
-  file.open(filename, std::ios_base::out);
+  CSVWriter file(filename);
+  file.header({"iBatch", "Idx", "distProxy", "Theta"});
 
   long double nomDistProxy = solve_order2_distance_intersection(-dist,
 								dist*std::cos(nomAngle),
@@ -213,19 +214,11 @@ void run(const InputArgs& args)
 	
 	//std::cout << distProxy << ", " << std::abs(nomDistProxy-distProxy) << std::endl;
 	
-	if(i==0 and ibatch==0)
-	  file << "iBatch,Idx,distProxy,Theta" << std::endl;
-
-	char str1[40], str2[40];
-	sprintf(str1, "%.20Lf", distProxy);
-	sprintf(str2, "%.20Lf", Thetas[i]);
-	
-	file << std::to_string( ibatch ) << ","
-	     << std::to_string( i ) << ","
-	  //	     << std::to_string( distProxy ) << ","
-	     << str1 << ","
-	     << str2
-	     << std::endl;	
+	file.field( ibatch )
+	  .field( i )
+	  .field( distProxy, 20 )
+	  .field( Thetas[i], 20 )
+	  .end_line();
       }
       
 
@@ -0,0 +1,108 @@
+#ifndef ACCEPTANCE_H
+#define ACCEPTANCE_H
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+////////////////////////////////////////////
+//which calorimeters a particle can reach from the plane where v1_beam starts it
+//The state is given at z = -side*(zcutoff+50) by the position x, y, the
+//slopes x' = px/pz and y' = py/pz and the momentum p, on a regular 5D grid;
+//each cell holds a bit mask of the reachable calorimeters (at most 8), so a
+//lookup is O(1). The map covers the particles moving towards one side of the
+//interaction point (the sign of pz), where its calorimeters are. It is only
+//valid for the tracking it was built with (mode, zcutoff and field scale).
+//States outside the grid were not tracked: they count as reaching every
+//calorimeter, so that they are tracked rather than dropped.
+//Layout of the binary file (little endian):
+// - 8 bytes magic "DFACCMAP", uint32 version, int32 side
+// - int32 tracking mode, float zcutoff, float field scale
+// - for x, y, x', y' and p: uint32 nbins, double lo, double hi
+// - uint32 ncalos, ncalos names of char[32]
+// - the product of the nbins uint8 masks, p running fastest
+////////////////////////////////////////////
+class AcceptanceMap {
+public:
+  static constexpr char mMagic[9] = "DFACCMAP";
+  static constexpr uint32_t mVersion = 2;
+  static constexpr std::size_t mNameSize = 32;
+  static constexpr std::size_t mMaxCalos = 8;
+  static constexpr std::size_t mNaxes = 5;
+
+  struct Axis {
+  public:
+    uint32_t nbins;
+    double lo;
+    double hi;
+
+    //-1 outside [lo, hi[
+    int bin(double v) const {
+      const double f = (v - lo) / (hi - lo);
+      return (f >= 0. and f < 1.) ? std::min(static_cast<int>(f * nbins), static_cast<int>(nbins) - 1) : -1;
+    }
+  };
+
+  //tracking the map was built with
+  struct Tracking {
+  public:
+    int32_t mode;
+    float zcutoff;
+    float Bscale;
+
+    bool operator==(const Tracking& o) const {
+      return mode==o.mode and zcutoff==o.zcutoff and Bscale==o.Bscale;
+    }
+  };
+
+  using State = std::array<double, mNaxes>; //x, y, x', y', p
+  using Axes = std::array<Axis, mNaxes>;
+
+  AcceptanceMap(const Axes& pAxes, int pSide, const Tracking& pTracking, const std::vector<std::string>& pCalos);
+
+  //flags the cell of the state as reaching calorimeter 'ic'
+  void mark(const State& s, unsigned ic);
+  //bit mask of the calorimeters reachable from the state
+  uint8_t reachable(const State& s) const {
+    std::size_t idx = 0;
+    for(unsigned a=0; a<mNaxes; ++a) {
+      const int b = mAxes[a].bin(s[a]);
+      if(b < 0)
+	return mAllCalos;
+      idx = idx*mAxes[a].nbins + b;
+    }
+    return mCells[idx];
+  }
+  //conservative margin: every cell also gets the masks of its neighbours up to 'ncells' away
+  void dilate(unsigned ncells);
+
+  int side() const { return mSide; }
+  const Tracking& tracking() const { return mTracking; }
+  const std::vector<std::string>& calos() const { return mCalos; }
+  const Axes& axes() const { return mAxes; }
+  //fraction of the cells from which some calorimeter is reachable
+  double occupancy() const;
+
+  void write(const std::string&) const;
+  static AcceptanceMap read(const std::string&);
+
+private:
+  Axes mAxes;
+  int mSide; //+1 or -1: sign of pz of the particles in the map
+  Tracking mTracking;
+  std::vector<std::string> mCalos;
+  uint8_t mAllCalos;
+  std::vector<uint8_t> mCells;
+
+  std::size_t index_(const std::array<int, mNaxes>& bins) const {
+    std::size_t idx = 0;
+    for(unsigned a=0; a<mNaxes; ++a)
+      idx = idx*mAxes[a].nbins + bins[a];
+    return idx;
+  }
+};
+
+#endif // ACCEPTANCE_H
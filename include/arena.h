@@ -0,0 +1,71 @@
+#ifndef ARENA_H
+#define ARENA_H
+
+#include <cstddef>
+#include <memory_resource>
+#include <optional>
+#include <vector>
+
+template <typename T> using PVec = std::pmr::vector<T>;
+
+////////////////////////////////////////////
+//memory arena for the temporaries of one batch
+//Allocations bump a pointer into a buffer that is kept between batches and
+//'reset' drops all of them at once. If a batch needs more than the buffer,
+//the excess comes from the heap and the buffer grows at the next reset, so
+//that after the first batches no heap allocation is made at all.
+//An arena is not thread-safe: use one per thread (pipeline stage).
+////////////////////////////////////////////
+class Arena {
+public:
+  explicit Arena(std::size_t pBytes = 1 << 16) : mBuffer(pBytes) { rebuild_(); }
+
+  Arena(const Arena&) = delete;
+  Arena& operator=(const Arena&) = delete;
+
+  std::pmr::memory_resource* resource() { return &*mResource; }
+
+  //everything allocated from the arena must be destroyed before calling this
+  void reset() {
+    if(mOverflow.bytes() > 0) {
+      const std::size_t needed = mBuffer.size() + mOverflow.bytes();
+      mResource.reset();
+      mBuffer.assign(2*needed, std::byte{0});
+    }
+    rebuild_();
+  }
+
+  std::size_t capacity() const { return mBuffer.size(); }
+
+private:
+  //heap fallback that remembers how much the buffer was short of
+  class CountingResource final : public std::pmr::memory_resource {
+  public:
+    std::size_t bytes() const { return mBytes; }
+    void clear() { mBytes = 0; }
+
+  private:
+    std::size_t mBytes = 0;
+
+    void* do_allocate(std::size_t n, std::size_t align) override {
+      mBytes += n + align;
+      return std::pmr::new_delete_resource()->allocate(n, align);
+    }
+    void do_deallocate(void* p, std::size_t n, std::size_t align) override {
+      std::pmr::new_delete_resource()->deallocate(p, n, align);
+    }
+    bool do_is_equal(const std::pmr::memory_resource& o) const noexcept override { return this == &o; }
+  };
+
+  std::vector<std::byte> mBuffer;
+  CountingResource mOverflow;
+  std::optional<std::pmr::monotonic_buffer_resource> mResource;
+
+  void rebuild_() {
+    mResource.reset(); //gives the overflow blocks back to the heap
+    mOverflow.clear();
+    mResource.emplace(mBuffer.data(), mBuffer.size(), &mOverflow);
+  }
+};
+
+#endif // ARENA_H
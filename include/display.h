@@ -0,0 +1,82 @@
+#ifndef DISPLAY_H
+#define DISPLAY_H
+
+#include "./geometry.h"
+#include "./simulation.h"
+#include "./tracking.h"
+#include <memory>
+#include <string>
+
+#include <TEveManager.h>
+#include "TEveLine.h"
+#include "TEveBox.h"
+
+////////////////////////////////////////////
+//beam axis and elements of the beamline in the event display
+////////////////////////////////////////////
+class BuildGeom {
+public:
+
+  BuildGeom(Dimensions ax,
+	    const MagnetSystem& pMagnetSyst,
+	    const CaloSystem& pCaloSyst)
+    : mMSyst(new MagnetSystem(pMagnetSyst)),
+      mCSyst(new CaloSystem(pCaloSyst))
+  {
+    init_(ax);
+    mMSyst->draw();
+    mCSyst->draw();
+  };
+
+  BuildGeom(Dimensions ax,
+	    const MagnetSystem& pMagnetSyst)
+    : mMSyst(new MagnetSystem(pMagnetSyst))
+  {
+    init_(ax);
+    mMSyst->draw();
+  };
+  
+  BuildGeom(Dimensions ax,
+	    const CaloSystem& pCaloSyst)
+    : mCSyst(new CaloSystem(pCaloSyst))
+  {
+    init_(ax);
+    mCSyst->draw();
+  };
+
+  void init_(const Dimensions& ax) {
+    TEveManager::Create();
+    draw_beam_axis_(ax);
+  }
+  
+  void draw_beam_axis_(Dimensions ax) {
+    TEveLine* bax = new TEveLine();
+    bax->SetNextPoint( ax.X1(), ax.Y1(), ax.Z1() );
+    bax->SetNextPoint( ax.X2(), ax.Y2(), ax.Z2() );
+    bax->SetName("beam_axis");
+    bax->SetLineStyle(9);
+    bax->SetLineWidth(1);
+    bax->SetMainAlpha(0.7);
+    bax->SetMainColor(kBlue);
+    gEve->AddElement(bax);
+  }
+  
+private:
+  std::unique_ptr<MagnetSystem> mMSyst;
+  std::unique_ptr<CaloSystem> mCSyst;
+};
+
+////////////////////////////////////////////
+//event display of '--draw' with ROOT's Eve
+//Only the executables with a front end link it, together with the Eve and
+//OpenGL libraries; the simulation library (and the headless executable)
+//never includes this header. The application must exist before drawing.
+////////////////////////////////////////////
+class EveDisplay final : public TrackDisplay {
+public:
+  void geometry(const MagnetSystem&, const CaloSystem&, float zcutoff) override;
+  void tracks(const Vec<Track>& tracks1, const Vec<Track>& tracks2, const Vec<unsigned char>& drawn) override;
+  void show() override;
+};
+
+#endif //DISPLAY_H
@@ -0,0 +1,118 @@
+#ifndef DUAL_H
+#define DUAL_H
+
+#include <array>
+#include <cmath>
+
+#include "Math/Vector3D.h" // XYZVector
+
+////////////////////////////////////////////
+//forward-mode automatic differentiation
+//A Dual carries a value and its derivatives with respect to N parameters;
+//every operation applies the chain rule, so a computation templated on the
+//scalar type returns its result and exact derivatives in one pass. The
+//comparisons only look at the values (branches are not differentiated).
+////////////////////////////////////////////
+template <unsigned N>
+class Dual {
+public:
+  double v; //value
+  std::array<double,N> d; //derivatives
+
+  Dual(double pV = 0.) : v(pV), d{} {}
+
+  //the i-th parameter, with value 'pV'
+  static Dual variable(double pV, unsigned i) {
+    Dual x(pV);
+    x.d[i] = 1.;
+    return x;
+  }
+
+  Dual& operator+=(const Dual& o) { v += o.v; for(unsigned i=0; i<N; ++i) d[i] += o.d[i]; return *this; }
+  Dual& operator-=(const Dual& o) { v -= o.v; for(unsigned i=0; i<N; ++i) d[i] -= o.d[i]; return *this; }
+  Dual& operator*=(double s) { v *= s; for(double& x : d) x *= s; return *this; }
+  Dual& operator/=(double s) { return *this *= 1. / s; }
+  Dual& operator*=(const Dual& o) { for(unsigned i=0; i<N; ++i) d[i] = d[i]*o.v + v*o.d[i]; v *= o.v; return *this; }
+  Dual& operator/=(const Dual& o) {
+    const double inv = 1. / o.v;
+    for(unsigned i=0; i<N; ++i) d[i] = (d[i] - v*inv*o.d[i]) * inv;
+    v *= inv;
+    return *this;
+  }
+  Dual operator-() const { Dual r(-v); for(unsigned i=0; i<N; ++i) r.d[i] = -d[i]; return r; }
+};
+
+template <unsigned N> Dual<N> operator+(Dual<N> a, const Dual<N>& b) { return a += b; }
+template <unsigned N> Dual<N> operator-(Dual<N> a, const Dual<N>& b) { return a -= b; }
+template <unsigned N> Dual<N> operator*(Dual<N> a, const Dual<N>& b) { return a *= b; }
+template <unsigned N> Dual<N> operator/(Dual<N> a, const Dual<N>& b) { return a /= b; }
+template <unsigned N> Dual<N> operator+(Dual<N> a, double b) { a.v += b; return a; }
+template <unsigned N> Dual<N> operator+(double a, Dual<N> b) { b.v += a; return b; }
+template <unsigned N> Dual<N> operator-(Dual<N> a, double b) { a.v -= b; return a; }
+template <unsigned N> Dual<N> operator-(double a, const Dual<N>& b) { return -b + a; }
+template <unsigned N> Dual<N> operator*(Dual<N> a, double b) { return a *= b; }
+template <unsigned N> Dual<N> operator*(double a, Dual<N> b) { return b * a; }
+template <unsigned N> Dual<N> operator/(Dual<N> a, double b) { return a * (1. / b); }
+template <unsigned N> Dual<N> operator/(double a, const Dual<N>& b) { return Dual<N>(a) / b; }
+
+template <unsigned N> bool operator<(const Dual<N>& a, const Dual<N>& b) { return a.v < b.v; }
+template <unsigned N> bool operator>(const Dual<N>& a, const Dual<N>& b) { return a.v > b.v; }
+template <unsigned N> bool operator<(const Dual<N>& a, double b) { return a.v < b; }
+template <unsigned N> bool operator>(const Dual<N>& a, double b) { return a.v > b; }
+template <unsigned N> bool operator==(const Dual<N>& a, double b) { return a.v == b; }
+
+//f(a) with f'(a) = 'df'
+template <unsigned N> Dual<N> chain(const Dual<N>& a, double f, double df) {
+  Dual<N> r(f);
+  for(unsigned i=0; i<N; ++i) r.d[i] = df * a.d[i];
+  return r;
+}
+
+template <unsigned N> Dual<N> sqrt(const Dual<N>& a) { const double s = std::sqrt(a.v); return chain(a, s, 0.5 / s); }
+template <unsigned N> Dual<N> abs(const Dual<N>& a) { return a.v < 0. ? -a : a; }
+template <unsigned N> Dual<N> sin(const Dual<N>& a) { return chain(a, std::sin(a.v), std::cos(a.v)); }
+template <unsigned N> Dual<N> cos(const Dual<N>& a) { return chain(a, std::cos(a.v), -std::sin(a.v)); }
+template <unsigned N> Dual<N> atan(const Dual<N>& a) { return chain(a, std::atan(a.v), 1. / (1. + a.v*a.v)); }
+template <unsigned N> Dual<N> atan2(const Dual<N>& y, const Dual<N>& x) {
+  const double r2 = x.v*x.v + y.v*y.v;
+  Dual<N> r(std::atan2(y.v, x.v));
+  for(unsigned i=0; i<N; ++i) r.d[i] = (x.v*y.d[i] - y.v*x.d[i]) / r2;
+  return r;
+}
+
+inline double value(double a) { return a; }
+template <unsigned N> double value(const Dual<N>& a) { return a.v; }
+
+////////////////////////////////////////////
+//three-vector of any scalar type (ROOT's vectors only hold plain numbers)
+////////////////////////////////////////////
+template <class T>
+class Vec3 {
+public:
+  T x, y, z;
+
+  Vec3() : x(0.), y(0.), z(0.) {}
+  Vec3(const T& pX, const T& pY, const T& pZ) : x(pX), y(pY), z(pZ) {}
+  explicit Vec3(const ROOT::Math::XYZVector& v) : x(v.X()), y(v.Y()), z(v.Z()) {}
+
+  Vec3& operator+=(const Vec3& o) { x += o.x; y += o.y; z += o.z; return *this; }
+  Vec3& operator-=(const Vec3& o) { x -= o.x; y -= o.y; z -= o.z; return *this; }
+  template <class S> Vec3& operator*=(const S& s) { x *= s; y *= s; z *= s; return *this; }
+  template <class S> Vec3& operator/=(const S& s) { x /= s; y /= s; z /= s; return *this; }
+  Vec3 operator-() const { return Vec3(-x, -y, -z); }
+
+  T Dot(const Vec3& o) const { return x*o.x + y*o.y + z*o.z; }
+  Vec3 Cross(const Vec3& o) const { return Vec3(y*o.z - z*o.y, z*o.x - x*o.z, x*o.y - y*o.x); }
+  T Mag2() const { return x*x + y*y + z*z; }
+
+  //values only
+  ROOT::Math::XYZVector xyz() const { return ROOT::Math::XYZVector(value(x), value(y), value(z)); }
+};
+
+template <class T> Vec3<T> operator+(Vec3<T> a, const Vec3<T>& b) { return a += b; }
+template <class T> Vec3<T> operator-(Vec3<T> a, const Vec3<T>& b) { return a -= b; }
+template <class T, class S> Vec3<T> operator*(Vec3<T> a, const S& s) { return a *= s; }
+template <class T, class S> Vec3<T> operator*(const S& s, Vec3<T> a) { return a *= s; }
+template <class T, class S> Vec3<T> operator/(Vec3<T> a, const S& s) { return a /= s; }
+
+#endif // DUAL_H
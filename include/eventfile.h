@@ -0,0 +1,110 @@
+#ifndef EVENTFILE_H
+#define EVENTFILE_H
+
+#include "./output.h"
+#include <cstdint>
+#include <fstream>
+#include <string>
+#include <vector>
+
+////////////////////////////////////////////
+//'histo' records stored column by column (structure of arrays)
+////////////////////////////////////////////
+struct HistoColumns {
+public:
+  template <typename T>
+  using Vec = std::vector<T>;
+
+  Vec<unsigned> iBatch, idx;
+  Vec<double> sumMomX, sumMomY, sumMomZ;
+  Vec<float> fermiPzBeforeBoost, fermiPzAfterBoost;
+  Vec<float> xHitNoBoost, yHitNoBoost, xHit, yHit;
+  Vec<float> psiA, psiB;
+  Vec<unsigned> cat1;
+  Vec<float> psi, phi, eta, cos;
+
+  void append(const HistoRecord&);
+  void clear(); //keeps the capacity
+  std::size_t size() const { return iBatch.size(); }
+
+  //calls f(name, numpy dtype, data pointer, element size) for every column,
+  //in the order of HistoRecord::columns()
+  template <class F>
+  void for_each_column(F&& f) const {
+    const auto& c = HistoRecord::columns();
+    f(c[0],  "<u4", iBatch.data(), sizeof(unsigned));
+    f(c[1],  "<u4", idx.data(), sizeof(unsigned));
+    f(c[2],  "<f8", sumMomX.data(), sizeof(double));
+    f(c[3],  "<f8", sumMomY.data(), sizeof(double));
+    f(c[4],  "<f8", sumMomZ.data(), sizeof(double));
+    f(c[5],  "<f4", fermiPzBeforeBoost.data(), sizeof(float));
+    f(c[6],  "<f4", fermiPzAfterBoost.data(), sizeof(float));
+    f(c[7],  "<f4", xHitNoBoost.data(), sizeof(float));
+    f(c[8],  "<f4", yHitNoBoost.data(), sizeof(float));
+    f(c[9],  "<f4", xHit.data(), sizeof(float));
+    f(c[10], "<f4", yHit.data(), sizeof(float));
+    f(c[11], "<f4", psiA.data(), sizeof(float));
+    f(c[12], "<f4", psiB.data(), sizeof(float));
+    f(c[13], "<u4", cat1.data(), sizeof(unsigned));
+    f(c[14], "<f4", psi.data(), sizeof(float));
+    f(c[15], "<f4", phi.data(), sizeof(float));
+    f(c[16], "<f4", eta.data(), sizeof(float));
+    f(c[17], "<f4", cos.data(), sizeof(float));
+  }
+};
+
+////////////////////////////////////////////
+//flat, memory-mappable event file
+//Layout (little endian):
+// - 8 bytes magic "DFEVENTS", uint32 version, uint32 ncols, uint64 nrows
+// - ncols column descriptors: char name[32], char dtype[8], uint64 offset
+// - column blocks of nrows fixed-width values, each 64-byte aligned
+//'dtype' follows numpy's notation ("<f4", "<f8", "<u4") so that
+//python/eventfile.py can open every column with np.memmap.
+////////////////////////////////////////////
+class EventFile {
+public:
+  static constexpr char mMagic[9] = "DFEVENTS";
+  static constexpr uint32_t mVersion = 1;
+  static constexpr std::size_t mNameSize = 32;
+  static constexpr std::size_t mTypeSize = 8;
+  static constexpr std::size_t mAlignment = 64;
+
+  static void write(const std::string&, const HistoColumns&);
+
+  //header and column descriptors of 'nrows' rows of the 'histo' record;
+  //returns the offset of every column block
+  static std::vector<uint64_t> write_header(std::ostream&, uint64_t nrows);
+};
+
+////////////////////////////////////////////
+//event file written batch by batch
+//Each 'flush' appends the buffered rows to '<filename>.part' as one segment
+//of column slices, so only one batch is held in memory. 'close' copies the
+//slices of every column into its block of the final file and removes the
+//segment file: the result is identical to EventFile::write.
+////////////////////////////////////////////
+class EventFileWriter {
+public:
+  explicit EventFileWriter(const std::string&);
+  ~EventFileWriter();
+
+  EventFileWriter(const EventFileWriter&) = delete;
+  EventFileWriter& operator=(const EventFileWriter&) = delete;
+
+  void append(const HistoRecord& r) { mBatch.append(r); }
+  void flush();
+  void close();
+
+  uint64_t rows() const { return mNrows + mBatch.size(); }
+
+private:
+  std::string mFilename;
+  std::string mPartName;
+  std::fstream mPart;
+  HistoColumns mBatch;
+  std::vector<uint64_t> mSegmentRows; //rows of every segment in the part file
+  uint64_t mNrows = 0;
+};
+
+#endif // EVENTFILE_H
@@ -0,0 +1,123 @@
+#ifndef FASTSIM_H
+#define FASTSIM_H
+
+#include "./geometry.h"
+#include "./tracking.h"
+#include <array>
+#include <future>
+#include <list>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <random>
+#include <vector>
+
+////////////////////////////////////////////
+//surrogate of the tracker: outcomes tabulated over the initial state
+//Particles are tracked once at the nodes of a regular grid over
+//(x, y, px, py, p), all starting at the same z and moving along the same
+//z direction as a template particle. Queries inside the grid are answered
+//by multilinear interpolation of the TrackSummary of the surrounding nodes;
+//those outside fall back to direct tracking. An axis with a single node
+//(e.g. px = py = 0 for the beams) does not take part in the interpolation.
+////////////////////////////////////////////
+class TrackTable {
+public:
+  template <typename T>
+  using Vec = std::vector<T>;
+  using XYZ = ROOT::Math::XYZVector;
+
+  enum Variable { X=0, Y, PX, PY, P, NVARS };
+
+  struct Axis {
+  public:
+    unsigned n; //number of nodes
+    double lo;
+    double hi;
+
+    double node(unsigned i) const { return n>1 ? lo + i*(hi-lo)/(n-1) : lo; }
+  };
+
+  //largest and root mean square differences to direct tracking, in cm and GeV/c
+  struct ErrorReport {
+  public:
+    unsigned nsamples = 0;
+    std::array<double,4> max = {{0., 0., 0., 0.}};
+    std::array<double,4> rms = {{0., 0., 0., 0.}};
+    static constexpr std::array<const char*,4> names = {{"last position", "last momentum",
+							 "closest position", "closest momentum"}};
+  };
+
+  //tracks every node; 'pTemplate' sets the starting z, the sign of pz, the mass, the energy and the charge
+  TrackTable(const Particle& pTemplate, const std::array<Axis,NVARS>& pAxes,
+	     const MagnetSystem& pMagnets, tracking::TrackMode pMode,
+	     unsigned pNsteps, double pStepSize, double pScale, float pZcutoff,
+	     ApproachReference pReference = ApproachReference());
+
+  //same outcome as SimParticle::summarize for a particle like the template
+  TrackSummary summarize(const Particle&) const;
+  bool contains(const Particle&) const;
+
+  //compares interpolated and tracked outcomes at random states inside the grid
+  ErrorReport validate(unsigned, std::mt19937&) const;
+
+  std::size_t size() const { return mNodes.size(); }
+
+private:
+  Particle mTemplate;
+  std::array<Axis,NVARS> mAxes;
+  std::array<std::size_t,NVARS> mStrides;
+  const MagnetSystem& mMagnets;
+  tracking::TrackMode mMode;
+  unsigned mNsteps;
+  double mStepSize;
+  double mScale;
+  float mZcutoff;
+  ApproachReference mReference;
+  Vec<TrackSummary> mNodes;
+
+  Particle particle_(const std::array<double,NVARS>&) const;
+  std::array<double,NVARS> state_(const Particle&) const;
+  TrackSummary track_(const Particle&) const;
+};
+
+////////////////////////////////////////////
+//track tables shared by the runs of one process (scans, fits, daemon)
+//Tables of one magnet system are kept under every other input of TrackTable
+//(template, axes, mode, stepping, field scale, zcutoff and closest approach
+//reference). A table being built by one run is waited for by the others
+//instead of being built twice; beyond 'capacity' tables, the least recently
+//used one is dropped (runs still using it keep it alive).
+////////////////////////////////////////////
+class TrackTableCache {
+public:
+  using Axes = std::array<TrackTable::Axis,TrackTable::NVARS>;
+
+  TrackTableCache(const MagnetSystem& pMagnets, std::size_t pCapacity=8)
+    : mMagnets(pMagnets), mCapacity(pCapacity) {}
+
+  std::shared_ptr<const TrackTable> get(const Particle&, const Axes&, tracking::TrackMode,
+					unsigned, double, double, float,
+					ApproachReference = ApproachReference());
+
+  std::size_t size() const;
+  unsigned long hits() const { return mHits; }
+  unsigned long misses() const { return mMisses; }
+
+private:
+  using Key = std::vector<double>;
+  using Table = std::shared_future<std::shared_ptr<const TrackTable>>;
+  struct Entry {
+    Table table;
+    std::list<Key>::iterator lru;
+  };
+
+  const MagnetSystem& mMagnets;
+  std::size_t mCapacity;
+  mutable std::mutex mMutex;
+  std::map<Key, Entry> mTables;
+  std::list<Key> mLru; //most recently used first
+  unsigned long mHits = 0, mMisses = 0;
+};
+
+#endif // FASTSIM_H
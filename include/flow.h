@@ -0,0 +1,110 @@
+#ifndef FLOW_H
+#define FLOW_H
+
+#include "./output.h"
+#include <array>
+#include <cmath>
+#include <fstream>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+
+////////////////////////////////////////////
+//online directed-flow (v1) estimators
+//Every produced particle contributes its azimuth 'phi' together with the
+//spectator planes of both beams ('psiA', and 'psiB' rotated by pi so that
+//both point to the same hemisphere). There is no two-particle cumulant:
+//the pairs of a run draw their beam positions independently, so two
+//particles never share a spectator plane to be correlated through.
+//All state is made of sums, so accumulators from different threads or
+//shards combine with 'merge' (or 'read' + 'merge' for files).
+//
+// - v1{EP} = <cos(phi - Psi)>, with Psi the combined spectator plane
+// - v1{SP} = <u.Q_A> / sqrt(<Q_A.Q_B>), u = exp(i*phi), Q = exp(i*psi)
+////////////////////////////////////////////
+class FlowAccumulator {
+public:
+  struct Estimate {
+    double value;
+    double error;
+  };
+
+  void add(float phi, float psi, float psiA, float psiB) {
+    const double c = std::cos(phi - psi);
+    mS[EP] += c;
+    mS[EP2] += c*c;
+
+    const double a = std::cos(phi - psiA);
+    const double b = std::cos(psiA - (psiB + M_PI));
+    mS[A] += a;
+    mS[A2] += a*a;
+    mS[B] += b;
+    mS[B2] += b*b;
+    mS[AB] += a*b;
+    mS[N] += 1.;
+  }
+
+  void merge(const FlowAccumulator& o) {
+    for(unsigned i=0; i<NSUMS; ++i)
+      mS[i] += o.mS[i];
+  }
+
+  Estimate v1_ep() const {
+    const double n = mS[N];
+    const double m = mS[EP] / n;
+    return {m, std::sqrt((mS[EP2]/n - m*m) / n)};
+  }
+
+  Estimate v1_sp() const {
+    //delta method for f = a / sqrt(b)
+    const double n = mS[N];
+    const double a = mS[A]/n, b = mS[B]/n;
+    const double va = mS[A2]/n - a*a;
+    const double vb = mS[B2]/n - b*b;
+    const double cab = mS[AB]/n - a*b;
+    const double f = a / std::sqrt(std::abs(b));
+    const double var = (va + a*a/(4*b*b)*vb - a/b*cab) / std::abs(b);
+    return {f, std::sqrt(std::max(0., var) / n)};
+  }
+
+  //estimates followed by the raw sums (needed to merge shards)
+  void write(const std::string& filename) const {
+    CSVWriter w(filename);
+    w.header({"Quantity", "Value", "Error"});
+    auto est = [&w](const char* name, Estimate e) {
+		 w.field(name).field(e.value, 10).field(e.error, 10).end_line();
+	       };
+    est("v1EP", v1_ep());
+    est("v1SP", v1_sp());
+    for(unsigned i=0; i<NSUMS; ++i)
+      w.field(mSumNames[i]).field(mS[i], 17).field(0., 1).end_line();
+  }
+
+  //reads back the sums stored by 'write'
+  static FlowAccumulator read(const std::string& filename) {
+    std::ifstream f(filename);
+    if(!f.is_open())
+      throw std::runtime_error("Failed to open " + filename);
+    FlowAccumulator acc;
+    std::string line;
+    std::getline(f, line); //header
+    while(std::getline(f, line)) {
+      std::stringstream ss(line);
+      std::string name, value;
+      std::getline(ss, name, ',');
+      std::getline(ss, value, ',');
+      for(unsigned i=0; i<NSUMS; ++i)
+	if(name == mSumNames[i])
+	  acc.mS[i] = std::stod(value);
+    }
+    return acc;
+  }
+
+private:
+  enum Sum { N, EP, EP2, A, A2, B, B2, AB, NSUMS };
+  static constexpr const char* mSumNames[NSUMS] = {"S_N", "S_EP", "S_EP2", "S_A", "S_A2", "S_B", "S_B2", "S_AB"};
+
+  std::array<double, NSUMS> mS = {};
+};
+
+#endif // FLOW_H
@@ -1,19 +1,78 @@
 #ifndef GENERATOR_H
 #define GENERATOR_H
 
-#include "TF1.h"
-#include "TGraph.h"
-#include "TH1D.h"
-#include "TRandom.h"
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <memory>
+#include <optional>
 #include <random>
+#include <stdexcept>
 #include <fstream>
+#include <vector>
+
+//seed of the random stream 'stream' of a run with seed 'seed' (none for seed 0: nondeterministic)
+inline std::optional<std::uint32_t> stream_seed(unsigned seed, unsigned stream) {
+  if(seed == 0)
+    return std::nullopt;
+  std::seed_seq seq{seed, stream};
+  std::uint32_t s;
+  seq.generate(&s, &s+1);
+  return s;
+}
+
+////////////////////////////////////////////
+//inverse cumulative distribution of a binned density
+//A draw picks a bin by bisection of the cumulative sums and a uniform position
+//inside it, as TH1::GetRandom does. The table is never modified after its
+//construction, so one table is shared by the generators of every run and thread.
+////////////////////////////////////////////
+class CumulativeTable {
+public:
+  CumulativeTable(double pLo, double pHi, const std::vector<double>& density)
+    : mLo(pLo), mWidth((pHi - pLo) / density.size()), mCdf(density.size() + 1, 0.) {
+    for(std::size_t i=0; i<density.size(); ++i)
+      mCdf[i+1] = mCdf[i] + std::max(density[i], 0.);
+    if(!(mCdf.back() > 0.))
+      throw std::invalid_argument("A sampled density must be positive somewhere.");
+    for(double& c : mCdf)
+      c /= mCdf.back();
+  }
+
+  //'f' evaluated at the centres of 'nbins' bins over [lo, hi]
+  template <class F>
+  static std::shared_ptr<const CumulativeTable> tabulate(F f, double lo, double hi, unsigned nbins) {
+    std::vector<double> density(nbins);
+    for(unsigned i=0; i<nbins; ++i)
+      density[i] = f(lo + (i + 0.5) * (hi - lo) / nbins);
+    return std::make_shared<const CumulativeTable>(lo, hi, density);
+  }
+
+  //'u' uniform in [0, 1[
+  double sample(double u) const {
+    const std::size_t nbins = mCdf.size() - 1;
+    const std::size_t i = std::min<std::size_t>(std::upper_bound(mCdf.begin(), mCdf.end(), u) - mCdf.begin(), nbins) - 1;
+    return mLo + (i + (u - mCdf[i]) / (mCdf[i+1] - mCdf[i])) * mWidth;
+  }
 
+private:
+  double mLo, mWidth;
+  std::vector<double> mCdf;
+};
+
+//Every generator owns its engine, so that generators living on different
+//threads never share state. Without a seed the engine is seeded from
+//std::random_device.
 template <class T>
 class Generator {
 public:
-  Generator() {
-    mRng = std::mt19937( mSeeder() );
-    gRandom->SetSeed(0);
+  explicit Generator(std::optional<std::uint32_t> pSeed = std::nullopt) {
+    if(pSeed)
+      mRng = std::mt19937( *pSeed );
+    else {
+      std::random_device seeder;
+      mRng = std::mt19937( seeder() );
+    }
   }
 
   virtual T generate() = 0;
@@ -29,16 +88,13 @@ public:
 
 protected:
   std::mt19937 mRng;
-  
-private:
-  std::random_device mSeeder;
 };
 
 template <class T>
 class UniformDistribution final : public Generator<T> {
 public:
 
-  UniformDistribution(T left, T right) : Generator<T>() {
+  UniformDistribution(T left, T right, std::optional<std::uint32_t> pSeed = std::nullopt) : Generator<T>(pSeed) {
     mDist = std::uniform_real_distribution<T>(left, right);
   }
   
@@ -52,7 +108,7 @@ template <class T>
 class BernoulliDistribution final : public Generator<T> {
 public:
 
-  BernoulliDistribution(T prob) : Generator<T>() {
+  BernoulliDistribution(T prob, std::optional<std::uint32_t> pSeed = std::nullopt) : Generator<T>(pSeed) {
     mDist = std::bernoulli_distribution(prob);
   }
   
@@ -67,7 +123,7 @@ template <class T>
 class NormalDistribution final : public Generator<T> {
 public:
 
-  NormalDistribution(T mean, T sigma) : Generator<T>() {
+  NormalDistribution(T mean, T sigma, std::optional<std::uint32_t> pSeed = std::nullopt) : Generator<T>(pSeed) {
     mDist = std::normal_distribution<T>(mean, sigma);
   }
   
@@ -77,73 +133,58 @@ private:
   std::normal_distribution<T> mDist;
 };
 
+//pT spectrum d2N/(2pi dpT dy) with the 1/pT term removed (the original pT distribution)
+//taken from here: http://sampa.if.usp.br/~suaide/blog/files/papers/PLB6372006.pdf
 template <class T>
 class BoltzmannDistribution final : public Generator<T> {
 public:
 
-  BoltzmannDistribution(T pB, T pTemp, T pN, T pM0)
-    : Generator<T>(), mB(pB), mTemp(pTemp), mN(pN), mM0(pM0) {    
-    mDist = new TF1("BoltzmannDistribution_generator",
-		    boltzmann_signature, 0.0, 100, 4); //GeV
-    mDist->SetNpx(5000);
-    mDist->SetParameters(mB, mTemp, mN, mM0);
-    // mDist->SetLineColor(kBlack);
-    // mDist->SetLineStyle(1);
-    // mDist->SetLineWidth(1);
-    //mDist->Draw();
-  }
+  BoltzmannDistribution(std::shared_ptr<const CumulativeTable> pTable, std::optional<std::uint32_t> pSeed = std::nullopt)
+    : Generator<T>(pSeed), mTable(std::move(pTable)) {}
 
-  T generate() { return mDist->GetRandom(); }
+  BoltzmannDistribution(T pB, T pTemp, T pN, T pM0, std::optional<std::uint32_t> pSeed = std::nullopt)
+    : BoltzmannDistribution(table(pB, pTemp, pN, pM0), pSeed) {}
 
-private:
-  TF1* mDist;
-  T mB, mTemp, mN, mM0;
-
-  static double boltzmann_signature(double* x_val, double* par) {
-    // One over pT term is removed -> original pT distribution
-    // Fit function for d2N/(2pi dpT dy)
-    // taken from here: http://sampa.if.usp.br/~suaide/blog/files/papers/PLB6372006.pdf
-    double pT, y, B, Temp, n, m0;
-    pT      = x_val[0];
-    B       = par[0];
-    Temp    = par[1];
-    n       = par[2];
-    m0      = par[3];
-    double mT = TMath::Sqrt(pT*pT+m0*m0);
-    y = pT*B/TMath::Power(1.0+(mT-m0)/(n*Temp),n);
-    return y;
+  T generate() { return mTable->sample(mUnif(this->mRng)); }
+
+  //spectrum over [0, 100] GeV, sampled on 5000 bins
+  static std::shared_ptr<const CumulativeTable> table(T B, T Temp, T n, T m0) {
+    return CumulativeTable::tabulate([=](double pT) {
+				       const double mT = std::sqrt(pT*pT + m0*m0);
+				       return pT*B / std::pow(1.0 + (mT-m0)/(n*Temp), n);
+				     }, 0.0, 100., 5000);
   }
+
+private:
+  std::shared_ptr<const CumulativeTable> mTable;
+  std::uniform_real_distribution<double> mUnif;
 };
 
 template <class T>
 class FermiDistribution final : public Generator<T> {
 public:
 
-  FermiDistribution() : Generator<T>() {    
-
-    mFermiProbGraph = new TGraph();
-    mFermiProbGraph->Set(mNPoints);
-    
-    mDist = new TH1D("h_fermi_prob","h_fermi_prob",
-		     static_cast<int>(mNPoints*2.5), 0, 0.65);
-    
-    for(int i(0); i<mNPoints; i++)
-      mFermiProbGraph->SetPoint(i, mPtFermi[i], mProbFermi[i]);
-
-    for(int i(1); i<=mDist->GetNbinsX(); i++)
-      {
-	double pt_val = mDist->GetBinCenter(i);
-        double value  = mFermiProbGraph->Eval(pt_val);
-        if(value < 0.0) value = 0.0;
-        mDist->SetBinContent(i,value);
-      }
-  }
+  FermiDistribution(std::shared_ptr<const CumulativeTable> pTable, std::optional<std::uint32_t> pSeed = std::nullopt)
+    : Generator<T>(pSeed), mTable(std::move(pTable)) {}
+
+  FermiDistribution(std::optional<std::uint32_t> pSeed = std::nullopt)
+    : FermiDistribution(table(), pSeed) {}
 
-  T generate() { return mDist->GetRandom(); }
+  T generate() { return mTable->sample(mUnif(this->mRng)); }
+
+  //measured momentum distribution, interpolated linearly (and extrapolated by
+  //its end segments, as TGraph::Eval does) over [0, 0.65] GeV on 177 bins
+  static std::shared_ptr<const CumulativeTable> table() {
+    return CumulativeTable::tabulate([](double pt) {
+				       const int i = std::clamp(static_cast<int>(std::upper_bound(mPtFermi, mPtFermi+mNPoints, pt) - mPtFermi) - 1, 0, mNPoints-2);
+				       const double f = (pt - mPtFermi[i]) / (mPtFermi[i+1] - mPtFermi[i]);
+				       return std::max(mProbFermi[i] + f * (mProbFermi[i+1] - mProbFermi[i]), 0.);
+				     }, 0., 0.65, static_cast<int>(mNPoints*2.5));
+  }
 
 private:
-  TGraph* mFermiProbGraph;
-  TH1D* mDist;
+  std::shared_ptr<const CumulativeTable> mTable;
+  std::uniform_real_distribution<double> mUnif;
   
   static constexpr int mNPoints = 71;
   static constexpr double mPtFermi[mNPoints] = {0.0206,0.0272,0.0322,0.0361,0.0419,0.0485,0.0551,0.0614,0.0664,0.0707,0.0773,0.0831,0.0901,0.0959,0.104,0.114,0.122,0.131,0.135,0.141,0.149,0.16,0.168,0.178,0.185,0.194,0.203,0.209,0.213,0.218,0.225,0.231,0.245,0.252,0.259,0.267,0.275,0.282,0.289,0.295,0.304,0.309,0.316,0.323,0.33,0.338,0.346,0.353,0.363,0.371,0.377,0.384,0.394,0.403,0.411,0.425,0.438,0.448,0.461,0.476,0.49,0.505,0.519,0.533,0.551,0.565,0.579,0.592,0.609,0.624,0.638};
@@ -1,16 +1,16 @@
 #ifndef GEOMETRY_H
 #define GEOMETRY_H
 
+#include <iostream>
 #include <string>
 #include <vector>
 
-#include <TEveManager.h>
-#include "TEveLine.h"
-#include "TEveBox.h"
-
 #include "TMath.h"
 #include "Math/Vector3D.h" // XYZVector
 
+#include "./dual.h"
+#include "./kinematics.h"
+
 //#include "./functions.h"
 
 ////////////////////////////////
@@ -85,8 +85,22 @@ public:
   MagnetSystem(const std::vector<Magnet>& pMagnets)
     : mMagnets(pMagnets) {};
   
-  void draw() const;
+  void draw() const; //event display, see display.h
   XYZ field(XYZ, double) const;
+  //the same for any scalar type (see dual.h), e.g. to differentiate with respect to the scale
+  template <class T>
+  Vec3<T> field(const Vec3<T>& pos, const T& scale) const;
+  //no field anywhere: the trajectories are straight lines (up to the fake deflection)
+  bool field_free(double scale=1.) const {
+    for(auto && info : mMagnets)
+      if(info.intensity.first != 0. or info.intensity.second != 0.)
+	return scale == 0.;
+    return true;
+  }
+  //the field at (x, y, -z) is (-Bx, -By, Bz) at (x, y, z): a z-reflected trajectory is a trajectory
+  //Holds when every magnet has a partner over the mirrored z range (itself, if centred at z = 0)
+  //with the intensities that reflect its field; overlapping magnets are not supported.
+  bool mirror_symmetric() const;
 
   const float get_sign_direction(double z) const {
     return z<0 ? -1.f : 1.f;
@@ -96,6 +110,56 @@ private:
   std::vector<Magnet> mMagnets;
 };
 
+template <class T>
+Vec3<T> MagnetSystem::field(const Vec3<T>& pos, const T& scale) const {
+  
+  Vec3<T> Bfield;
+  const double fieldDir = 1.0;
+  const double z = value(pos.z);
+    
+  for(auto && info : mMagnets)
+    {
+      if(info.type == Magnet::DipoleX)
+	{
+	  if(z < info.dims.Z().second and z > info.dims.Z().first) {
+	    if(info.intensity.second != 0)
+	      std::cout << "Are you sure this is a dipole along x?"<< std::endl;
+	    T fieldIntensity = info.intensity.first*fieldDir*scale;
+	    Bfield = Vec3<T>(fieldIntensity, 0., 0.);
+	  }
+	}
+	
+      else if(info.type == Magnet::DipoleY)
+	{
+	  if(z < info.dims.Z().second and z > info.dims.Z().first) {
+	    if(info.intensity.first != 0)
+	      std::cout << "Are you sure this is a dipole along y?"<< std::endl;
+	    T fieldIntensity = info.intensity.second*fieldDir*scale;
+	    fieldIntensity *= z<0 ? -1. : 1.;
+	    Bfield = Vec3<T>(0., fieldIntensity, 0.);
+	  }
+	}
+
+      else if(info.type == Magnet::Quadrupole)
+	{
+	  if(z < info.dims.Z().first and z > info.dims.Z().second) {
+	    if(info.intensity.second == 0 or info.intensity.first == 0)
+	      std::cout << "Are you sure this is a quadrupole?"<< std::endl;
+
+	    // dividing by 100 to convert from centimeters to meters (assuming coordinates were given in cm)
+	    T fieldIntensityX = info.intensity.first*fieldDir*scale*pos.y / 100.;
+	    T fieldIntensityY = info.intensity.second*fieldDir*scale*pos.x / 100.;
+	    
+	    const double sign = get_sign_direction(z);
+	    fieldIntensityX *= sign;
+	    fieldIntensityY *= sign;
+	    Bfield = Vec3<T>(fieldIntensityX, fieldIntensityY, 0.);
+	  }
+	}
+    }
+  return Bfield;
+}
+
 ////////////////////////////////
 /////Group of Calorimeters//////
 ////////////////////////////////
@@ -105,85 +169,19 @@ public:
   CaloSystem(const std::vector<Calo>& pCalos)
     : mCalos(pCalos) {};
   
-  void draw() const;
-
-private:
-  std::vector<Calo> mCalos;
-};
+  void draw() const; //event display, see display.h
 
+  //where the straight lines pos + t*dir (t >= 0) enter calorimeter 'ic'; 'accepted' flags the hits
+  //Assumes there is no field between the starting points and the calorimeter.
+  void hits(unsigned ic,
+	    const kinematics::ThreeVectors& pos, const kinematics::ThreeVectors& dir,
+	    kinematics::ThreeVectors& hit, unsigned char* accepted) const;
 
-class BuildGeom {
-public:
+  const std::vector<Calo>& calos() const { return mCalos; }
+  std::size_t size() const { return mCalos.size(); }
 
-  BuildGeom(Dimensions ax,
-	    const MagnetSystem& pMagnetSyst,
-	    const CaloSystem& pCaloSyst)
-    : mMSyst(new MagnetSystem(pMagnetSyst)),
-      mCSyst(new CaloSystem(pCaloSyst))
-  {
-    init_(ax);
-    mMSyst->draw();
-    mCSyst->draw();
-  };
-
-  BuildGeom(Dimensions ax,
-	    const MagnetSystem& pMagnetSyst)
-    : mMSyst(new MagnetSystem(pMagnetSyst))
-  {
-    init_(ax);
-    mMSyst->draw();
-  };
-  
-  BuildGeom(Dimensions ax,
-	    const CaloSystem& pCaloSyst)
-    : mCSyst(new CaloSystem(pCaloSyst))
-  {
-    init_(ax);
-    mCSyst->draw();
-  };
-
-  void init_(const Dimensions& ax) {
-    TEveManager::Create();
-    draw_beam_axis_(ax);
-  }
-  
-  void draw_beam_axis_(Dimensions ax) {
-    TEveLine* bax = new TEveLine();
-    bax->SetNextPoint( ax.X1(), ax.Y1(), ax.Z1() );
-    bax->SetNextPoint( ax.X2(), ax.Y2(), ax.Z2() );
-    bax->SetName("beam_axis");
-    bax->SetLineStyle(9);
-    bax->SetLineWidth(1);
-    bax->SetMainAlpha(0.7);
-    bax->SetMainColor(kBlue);
-    gEve->AddElement(bax);
-  }
-  
 private:
-  std::unique_ptr<MagnetSystem> mMSyst;
-  std::unique_ptr<CaloSystem> mCSyst;
+  std::vector<Calo> mCalos;
 };
 
 #endif //GEOMETRY_H
-
-  // void draw_beams_() {
-
-  //   const unsigned nbeams = 2;
-  //   std::array<std::string,nbeams> names_ = { {"incoming beam",
-  // 					       "outgoing beam"} };
-  //   std::array<Dimensions,nbeams> coords_{{ Dimensions{9.3,  0., 0., 0., -6300-5840., 0.},
-  // 					    Dimensions{-9.3, 0., 0., 0., -6300-5840., 0.} }};
-  //   std::array<unsigned,nbeams> colors_ = {{kGreen-9,kGreen-1}};
-  //   for(unsigned i=0; i<2; ++i) {
-  //     TEveLine* TEveLine_beam_axis = NULL;
-  //     TEveLine_beam_axis = new TEveLine();
-  //     TEveLine_beam_axis ->SetNextPoint( coords_[i].X().first,  coords_[i].Y().first,  coords_[i].Z().first  );
-  //     TEveLine_beam_axis ->SetNextPoint( coords_[i].X().second, coords_[i].Y().second, coords_[i].Z().second );
-  //     TEveLine_beam_axis ->SetName( names_[i].c_str() );
-  //     TEveLine_beam_axis ->SetLineStyle(1);
-  //     TEveLine_beam_axis ->SetLineWidth(1);
-  //     TEveLine_beam_axis ->SetMainAlpha(0.8);
-  //     TEveLine_beam_axis ->SetMainColor( colors_[i] );
-  //     gEve->AddElement(TEveLine_beam_axis);
-  //   }
-  // }
@@ -0,0 +1,176 @@
+#ifndef HISTOGRAM_H
+#define HISTOGRAM_H
+
+#include "./output.h"
+#include <algorithm>
+#include <cmath>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+////////////////////////////////////////////
+//fixed binning along one axis
+//bin 0 is the underflow and bin nbins+1 the overflow, which also gets NaN
+////////////////////////////////////////////
+class Axis {
+public:
+  Axis(unsigned pNbins, double pLow, double pHigh)
+    : mNbins(pNbins), mLow(pLow), mHigh(pHigh), mInvWidth(pNbins/(pHigh-pLow)) {
+    if(pNbins == 0 or !(pHigh > pLow))
+      throw std::invalid_argument("Invalid histogram binning.");
+  }
+
+  unsigned find_bin(double x) const {
+    if(x < mLow) return 0;
+    if(!(x < mHigh)) return mNbins+1; //NaN too
+    unsigned b = static_cast<unsigned>((x-mLow) * mInvWidth) + 1;
+    return b > mNbins ? mNbins : b; //protect against rounding at the upper edge
+  }
+
+  //neighbouring bins 'b' and 'b+1' whose centres surround x, and the fraction 'f' of the way
+  //from the first centre to the second (the under/overflow centres are half a bin outside)
+  void neighbours(double x, unsigned& b, double& f) const {
+    const double t = (x-mLow) * mInvWidth + 0.5;
+    if(t <= 0.) { b = 0; f = 0.; return; }
+    if(!(t < mNbins+1)) { b = mNbins; f = 1.; return; } //NaN too
+    b = static_cast<unsigned>(t);
+    f = t - b;
+  }
+
+  unsigned nbins() const { return mNbins; }
+  double low_edge(unsigned b) const { return mLow + (b-1) / mInvWidth; }
+  double high_edge(unsigned b) const { return mLow + b / mInvWidth; }
+
+  bool operator==(const Axis& o) const {
+    return mNbins==o.mNbins and mLow==o.mLow and mHigh==o.mHigh;
+  }
+
+private:
+  unsigned mNbins;
+  double mLow, mHigh;
+  double mInvWidth;
+};
+
+////////////////////////////////////////////
+//mergeable one-dimensional histogram
+////////////////////////////////////////////
+class Histo1D {
+public:
+  Histo1D(std::string pName, unsigned pNbins, double pLow, double pHigh)
+    : mName(pName), mX(pNbins, pLow, pHigh), mContent(pNbins+2, 0.) {};
+
+  void fill(double x, double w=1.) { mContent[mX.find_bin(x)] += w; }
+
+  //cloud-in-cell: the weight is shared linearly between the two bins whose centres surround x,
+  //so that the contents change continuously with x (as a fit objective needs)
+  void fill_smooth(double x, double w=1.) {
+    unsigned b;
+    double f;
+    mX.neighbours(x, b, f);
+    mContent[b] += (1.-f) * w;
+    mContent[b+1] += f * w;
+  }
+
+  //adds the contents of a histogram with identical binning (other thread, shard, ...)
+  void merge(const Histo1D& o) {
+    if(!(mX == o.mX))
+      throw std::invalid_argument("Cannot merge histograms with different binnings: " + mName);
+    for(unsigned i=0; i<mContent.size(); ++i)
+      mContent[i] += o.mContent[i];
+  }
+
+  void reset() { std::fill(mContent.begin(), mContent.end(), 0.); }
+
+  const std::string& name() const { return mName; }
+  const Axis& axis() const { return mX; }
+  double content(unsigned b) const { return mContent[b]; }
+  const std::vector<double>& contents() const { return mContent; } //by bin, under/overflow included
+
+  //one row per bin, under/overflow included (see 'histo_header')
+  void write(CSVWriter& w) const {
+    for(unsigned b=0; b<mContent.size(); ++b) {
+      w.field(mName).field(b).field(0u)
+	.field(b==0 ? -INFINITY : mX.low_edge(b), 10)
+	.field(b==mX.nbins()+1 ? INFINITY : mX.high_edge(b), 10)
+	.field(0., 1).field(0., 1)
+	.field(mContent[b])
+	.end_line();
+    }
+  }
+
+private:
+  std::string mName;
+  Axis mX;
+  std::vector<double> mContent;
+};
+
+////////////////////////////////////////////
+//mergeable two-dimensional histogram
+////////////////////////////////////////////
+class Histo2D {
+public:
+  Histo2D(std::string pName,
+	  unsigned pNbinsX, double pLowX, double pHighX,
+	  unsigned pNbinsY, double pLowY, double pHighY)
+    : mName(pName), mX(pNbinsX, pLowX, pHighX), mY(pNbinsY, pLowY, pHighY),
+      mContent((pNbinsX+2)*(pNbinsY+2), 0.) {};
+
+  void fill(double x, double y, double w=1.) {
+    mContent[index_(mX.find_bin(x), mY.find_bin(y))] += w;
+  }
+
+  //bilinear cloud-in-cell, as Histo1D::fill_smooth
+  void fill_smooth(double x, double y, double w=1.) {
+    unsigned bx, by;
+    double fx, fy;
+    mX.neighbours(x, bx, fx);
+    mY.neighbours(y, by, fy);
+    mContent[index_(bx, by)] += (1.-fx) * (1.-fy) * w;
+    mContent[index_(bx+1, by)] += fx * (1.-fy) * w;
+    mContent[index_(bx, by+1)] += (1.-fx) * fy * w;
+    mContent[index_(bx+1, by+1)] += fx * fy * w;
+  }
+
+  void merge(const Histo2D& o) {
+    if(!(mX == o.mX and mY == o.mY))
+      throw std::invalid_argument("Cannot merge histograms with different binnings: " + mName);
+    for(unsigned i=0; i<mContent.size(); ++i)
+      mContent[i] += o.mContent[i];
+  }
+
+  void reset() { std::fill(mContent.begin(), mContent.end(), 0.); }
+
+  const std::string& name() const { return mName; }
+  const Axis& xaxis() const { return mX; }
+  const Axis& yaxis() const { return mY; }
+  double content(unsigned bx, unsigned by) const { return mContent[index_(bx, by)]; }
+  const std::vector<double>& contents() const { return mContent; } //row-major in (bx, by), under/overflows included
+
+  void write(CSVWriter& w) const {
+    for(unsigned bx=0; bx<mX.nbins()+2; ++bx)
+      for(unsigned by=0; by<mY.nbins()+2; ++by) {
+	w.field(mName).field(bx).field(by)
+	  .field(bx==0 ? -INFINITY : mX.low_edge(bx), 10)
+	  .field(bx==mX.nbins()+1 ? INFINITY : mX.high_edge(bx), 10)
+	  .field(by==0 ? -INFINITY : mY.low_edge(by), 10)
+	  .field(by==mY.nbins()+1 ? INFINITY : mY.high_edge(by), 10)
+	  .field(mContent[index_(bx, by)])
+	  .end_line();
+      }
+  }
+
+private:
+  std::string mName;
+  Axis mX, mY;
+  std::vector<double> mContent;
+
+  unsigned index_(unsigned bx, unsigned by) const { return bx*(mY.nbins()+2) + by; }
+};
+
+//columns shared by the 1D and 2D histogram rows
+inline const std::vector<std::string>& histo_header() {
+  static const std::vector<std::string> c = {"Name", "BinX", "BinY", "XLow", "XHigh", "YLow", "YHigh", "Content"};
+  return c;
+}
+
+#endif // HISTOGRAM_H
@@ -0,0 +1,123 @@
+#ifndef KINEMATICS_H
+#define KINEMATICS_H
+
+#include "./arena.h"
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+
+#include "Math/Vector3D.h" // XYZVector
+
+////////////////////////////////////////////
+//batched relativistic kinematics on structures of arrays
+//Takes over from per-event TVector3/TLorentzVector objects: each kernel is a
+//flat loop over contiguous arrays, without branches or library calls, that
+//the compiler vectorizes. atan2 and log use polynomial approximations with
+//errors below 1e-10, far under the float precision of the outputs. Results
+//follow the TVector3/TLorentzVector conventions (Phi, PseudoRapidity, Boost).
+////////////////////////////////////////////
+namespace kinematics {
+  using XYZ = ROOT::Math::XYZVector;
+
+  struct ThreeVectors {
+  public:
+    static constexpr std::size_t narrays = 3; //arrays of doubles per element
+
+    ThreeVectors(std::size_t n, std::pmr::memory_resource* mem)
+      : x(n, 0., mem), y(n, 0., mem), z(n, 0., mem) {}
+
+    std::size_t size() const { return x.size(); }
+    void set(std::size_t i, const XYZ& v) { x[i] = v.X(); y[i] = v.Y(); z[i] = v.Z(); }
+
+    PVec<double> x, y, z;
+  };
+
+  struct FourVectors {
+  public:
+    static constexpr std::size_t narrays = ThreeVectors::narrays + 1;
+
+    FourVectors(std::size_t n, std::pmr::memory_resource* mem)
+      : p(n, mem), e(n, 0., mem) {}
+
+    std::size_t size() const { return e.size(); }
+
+    ThreeVectors p;
+    PVec<double> e;
+  };
+
+  //atan2 with the same quadrants as std::atan2
+  inline double fast_atan2(double y, double x) {
+    constexpr double tan15 = 0.26794919243112270; //tan(pi/12)
+    constexpr double sqrt3 = 1.7320508075688772;
+    const double ax = std::abs(x), ay = std::abs(y);
+    const double mx = std::max(ax, ay), mn = std::min(ax, ay);
+    //selects only pick operands (no division is conditional), so that loops are if-converted
+    const double t = mn / (mx > 0. ? mx : 1.);
+    //atan(t) = pi/6 + atan((sqrt3*t - 1) / (t + sqrt3)) brings the argument to |u| <= tan(pi/12)
+    const bool big = t > tan15;
+    const double reduced = (sqrt3*t - 1.) / (t + sqrt3);
+    const double u = big ? reduced : t;
+    const double u2 = u*u;
+    const double p = u * (1. + u2*(-1./3 + u2*(1./5 + u2*(-1./7 + u2*(1./9 + u2*(-1./11
+		       + u2*(1./13 + u2*(-1./15))))))));
+    double r = (big ? M_PI/6 : 0.) + p;
+    r = ay > ax ? M_PI/2 - r : r;
+    r = x < 0. ? M_PI - r : r;
+    return y < 0. ? -r : r;
+  }
+
+  //natural logarithm of a positive normal number
+  inline double fast_log(double x) {
+    std::uint64_t bits;
+    std::memcpy(&bits, &x, sizeof bits);
+    double e = static_cast<double>(static_cast<int>((bits >> 52) & 0x7ff) - 1023);
+    bits = (bits & 0x000fffffffffffffull) | 0x3ff0000000000000ull; //mantissa in [1,2)
+    double m;
+    std::memcpy(&m, &bits, sizeof m);
+    const bool high = m > M_SQRT2;
+    m = high ? 0.5*m : m;
+    e = high ? e + 1. : e;
+    //log(m) = 2*atanh(s), |s| <= 0.172
+    const double s = (m - 1.) / (m + 1.);
+    const double s2 = s*s;
+    const double l = 2.*s * (1. + s2*(1./3 + s2*(1./5 + s2*(1./7 + s2*(1./9 + s2*(1./11 + s2*(1./13)))))));
+    return e*M_LN2 + l;
+  }
+
+  //angle between two vectors, as TVector3::Angle
+  inline double angle(const XYZ& a, const XYZ& b) {
+    const double ptot2 = a.Mag2() * b.Mag2();
+    if(ptot2 <= 0.)
+      return 0.;
+    return std::acos(std::clamp(a.Dot(b) / std::sqrt(ptot2), -1., 1.));
+  }
+
+  //out = v.u
+  void dot(const ThreeVectors& v, const XYZ& u, double* out);
+  //out = scale * (v/|v|).u : where the direction of 'v' crosses a sphere of radius 'scale'
+  void direction_dot(const ThreeVectors& v, const XYZ& u, double scale, double* out);
+  //element-wise std::atan2(y, x)
+  void atan2(const double* y, const double* x, std::size_t n, double* out);
+  //azimuth, as TVector3::Phi ([-pi,pi], 0 for a null transverse momentum)
+  void phi(const ThreeVectors& v, double* out);
+  //pseudorapidity, as TVector3::PseudoRapidity (+-1e11 along the z axis)
+  void eta(const ThreeVectors& v, double* out);
+
+  //e = sqrt(p^2 + m^2)
+  void set_mass(FourVectors& v, double mass);
+  //out = a + b
+  void add(const FourVectors& a, const FourVectors& b, FourVectors& out);
+  //velocity p/e of each four-vector, as TLorentzVector::BoostVector
+  void boost_vectors(const FourVectors& v, ThreeVectors& beta);
+  //boosts each four-vector by its own velocity, as TLorentzVector::Boost
+  void boost(FourVectors& v, const ThreeVectors& beta);
+
+  //where each ray pos + t*dir (t >= 0) enters the axis-aligned box [lo, hi] (slab test)
+  //'accepted' is 0 for the rays that miss it; a ray starting inside the box enters at 'pos'
+  void intersect_box(const ThreeVectors& pos, const ThreeVectors& dir,
+		     const XYZ& lo, const XYZ& hi,
+		     ThreeVectors& hit, unsigned char* accepted);
+}
+
+#endif // KINEMATICS_H
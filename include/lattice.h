@@ -0,0 +1,71 @@
+#ifndef LATTICE_H
+#define LATTICE_H
+
+#include "./geometry.h"
+#include "./utils.h"
+
+////////////////////////////////////////////
+//ALICE elements shared by the executables
+////////////////////////////////////////////
+inline Vec<Magnet> magnet_lattice() {
+  return Vec<Magnet>{
+     // {Magnet::DipoleY,    "D1_neg", kBlue,    std::make_pair(0.,-3.529),
+     //  Geometry::Dimensions{-10., 10., -10., 10., -5840.0-945.0, -5840.0}
+     // },
+     
+     // {Magnet::Quadrupole, "Q4_neg", kYellow,  std::make_pair(200.34,-200.34),
+     //  Geometry::Dimensions{-10., 10., -10., 10., -4730.0-630.0, -4730.0}
+     // },
+     
+     // {Magnet::Quadrupole, "Q3_neg", kYellow,  std::make_pair(-200.34,200.34),
+     //  Geometry::Dimensions{-10., 10., -10., 10., -3830.0-550.0, -3830.0}
+     // },
+     
+     // {Magnet::Quadrupole, "Q2_neg", kYellow,  std::make_pair(-200.34,200.34),
+     //  Geometry::Dimensions{-10., 10., -10., 10., -3180.0-550.0, -3180.0}
+     // },
+     
+     // {Magnet::Quadrupole, "Q1_neg", kYellow,  std::make_pair(200.34,-200.34),
+     //  Geometry::Dimensions{-10., 10., -10., 10., -2300.0-630.0, -2300.0}
+     // },
+      
+     // {Magnet::DipoleX,    "D_corr", kBlue+1,  std::make_pair(-1.1716,0.),
+     //  Geometry::Dimensions{-10., 10., -10., 10., -1920.0-190.0, -1920.0}
+     // },
+      
+     // {Magnet::DipoleX,    "Muon"  , kMagenta, std::make_pair(0.67,0.),
+     //  Geometry::Dimensions{-10., 10., -10., 10., -750.0-430.0,  -750.0}
+     // },
+      
+     // {Magnet::Quadrupole, "Q1_pos", kYellow,  std::make_pair(200.34,-200.34),
+     //  Geometry::Dimensions{-10., 10., -10., 10., 2300.0, 2300.0+630.0}
+     // },
+      
+     // {Magnet::Quadrupole, "Q2_pos", kYellow,  std::make_pair(-200.34,200.34),
+     //  Geometry::Dimensions{-10., 10., -10., 10., 3180.0, 3180.0+550.0}
+     // },
+      
+     // {Magnet::Quadrupole, "Q3_pos", kYellow,  std::make_pair(-200.34,200.34),
+     //  Geometry::Dimensions{-10., 10., -10., 10., 3830.0, 3830.0+550.0}
+     // },
+      
+     // {Magnet::Quadrupole, "Q4_pos", kYellow,  std::make_pair(200.34,-200.34),
+     //  Geometry::Dimensions{-10., 10., -10., 10., 4730.0, 4730.0+630.0}
+     // },
+      
+     // {Magnet::DipoleY,    "D1_pos", kBlue,    std::make_pair(0.,-3.529),
+     //  Geometry::Dimensions{-10., 10., -10., 10., 5840.0, 5840.0+945.0}
+     // }
+  };
+}
+
+//figure 3.3 in ALICE ZDC TDR (which does not agree perfectly with the text: see dimensions in Chapters 3.4 and 3.5)
+//available on July 15th 2021 here: https://cds.cern.ch/record/381433/files/Alice-TDR.pdf
+inline Vec<Calo> zdc_calos() {
+  return Vec<Calo>{
+    {Calo::Neutron, "NeutronZDC", kCyan-3, Dimensions{-8/2., 8./2., -8/2., 8/2., -11613, -11613+100}},
+    {Calo::Proton,  "ProtonZDC",  kCyan+3, Dimensions{10.82, 10.82+22., -13./2., 13./2., -11563, -11563+150}}
+  };
+}
+
+#endif // LATTICE_H
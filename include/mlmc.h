@@ -0,0 +1,82 @@
+#ifndef MLMC_H
+#define MLMC_H
+
+#include "./geometry.h"
+#include "./tracking.h"
+#include <cmath>
+#include <cstdint>
+#include <functional>
+#include <optional>
+#include <random>
+#include <stdexcept>
+#include <vector>
+
+////////////////////////////////////////////
+//multilevel Monte Carlo over the tracker step size
+//level 0 tracks with the coarsest step; level l>0 samples the difference
+//between a track with step h/r^l and one with step h/r^(l-1), both started
+//from the same Particle. Levels are added up to a maximum until the finest
+//correction, which bounds the remaining bias, is below tolerance/sqrt(2)
+//The tracks are only summarised (see SimParticle::summarize).
+////////////////////////////////////////////
+class MultilevelMC {
+public:
+  template <typename T>
+  using Vec = std::vector<T>;
+
+  //draws the initial state of one sample
+  using Sampler = std::function<Particle(std::mt19937&)>;
+  //maps a track to the quantity to average
+  using Observable = std::function<double(const TrackSummary&)>;
+
+  struct Level {
+    unsigned nsamples = 0;
+    double sum = 0.;
+    double sum2 = 0.;
+    double cost = 0.; //number of integration steps spent on this level
+
+    double mean() const { return nsamples>0 ? sum/nsamples : 0.; }
+    double variance() const;
+    double cost_per_sample() const { return nsamples>0 ? cost/nsamples : 0.; }
+  };
+
+  MultilevelMC(const MagnetSystem& pMagnets, tracking::TrackMode pMode,
+	       unsigned pNsteps, double pStepSize,
+	       unsigned pMaxLevels, unsigned pRefinement=2,
+	       ApproachReference pReference = ApproachReference(),
+	       std::optional<std::uint32_t> pSeed = std::nullopt) //none: seeded from std::random_device
+    : mMagnets(pMagnets), mMode(pMode),
+      mNsteps(pNsteps), mStepSize(pStepSize),
+      mMaxLevels(pMaxLevels), mRefinement(pRefinement), mReference(pReference),
+      mRng(pSeed ? *pSeed : std::random_device{}()) {};
+
+  //Giles' algorithm: pilot run on the first two levels, add samples until the
+  //estimator variance is below tolerance^2/2, then add levels until the bias
+  //estimate is below tolerance/sqrt(2) or the maximum number of levels is used
+  double estimate(Sampler, Observable, double, unsigned, double scale=1., float zcutoff=0.f);
+
+  double variance() const;
+  //|E[P_L - P_{L-1}]| of the finest level, NaN with a single level
+  double bias() const;
+  //standard error of the mean of level l
+  double standard_error(unsigned l) const;
+  const Vec<Level>& levels() const { return mLevels; }
+  double step_size(unsigned l) const { return mStepSize / std::pow(mRefinement, l); }
+  unsigned nsteps(unsigned l) const { return mNsteps * std::pow(mRefinement, l); }
+
+private:
+  const MagnetSystem& mMagnets;
+  tracking::TrackMode mMode;
+  unsigned mNsteps;
+  double mStepSize;
+  unsigned mMaxLevels;
+  unsigned mRefinement;
+  ApproachReference mReference; //closest approach of the tracks
+  Vec<Level> mLevels;
+  std::mt19937 mRng;
+
+  void sample_level(unsigned, unsigned, Sampler&, Observable&, double, float);
+  void allocate_(double, Sampler&, Observable&, double, float);
+};
+
+#endif // MLMC_H
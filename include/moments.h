@@ -0,0 +1,59 @@
+#ifndef MOMENTS_H
+#define MOMENTS_H
+
+#include "./geometry.h"
+#include "./tracking.h"
+#include <utility>
+
+#include "Math/SMatrix.h"
+
+////////////////////////////////////////////
+//transport of the mean and covariance (sigma matrix) of a beam
+//The beam starts from the state of a particle at its mean position, with a
+//Gaussian spread of (x, y). The tracking is linearised around the mean by
+//central finite differences: the outcomes have the covariance J Sigma J^T,
+//J being the Jacobian of the map. The outcomes are the direction of the last
+//position, the last momentum and the position of the closest approach, which
+//(unlike the last position) do not jump when an offset changes the number of
+//steps. Five tracks per beam replace the sampling of the whole beam, as long
+//as the map is close to linear over a few beam widths.
+////////////////////////////////////////////
+class BeamTransport {
+public:
+  enum Outcome { DirX=0, DirY, DirZ, MomX, MomY, MomZ, ClosestX, ClosestY, ClosestZ, NOUT };
+
+  using Sigma = ROOT::Math::SMatrix<double,2,2,ROOT::Math::MatRepSym<double,2>>; //covariance of (x, y) [cm^2]
+  using Jacobian = ROOT::Math::SMatrix<double,NOUT,2>;
+  using Outcomes = ROOT::Math::SVector<double,NOUT>;
+  using Covariance = ROOT::Math::SMatrix<double,NOUT,NOUT,ROOT::Math::MatRepSym<double,NOUT>>;
+
+  struct Moments {
+  public:
+    Outcomes mean;
+    Covariance cov;
+
+    //mean and standard deviation of f(outcomes), given f at the mean and its gradient
+    std::pair<double,double> propagate(double value, const Outcomes& gradient) const;
+  };
+
+  BeamTransport(const MagnetSystem& pMagnets, tracking::TrackMode pMode,
+		unsigned pNsteps, double pStepSize, double pScale, float pZcutoff,
+		ApproachReference pReference = ApproachReference());
+
+  Outcomes outcomes(const Particle&) const;
+  //derivatives of the outcomes with respect to the initial x and y, with offsets of 'delta' cm
+  Jacobian jacobian(const Particle&, double delta) const;
+  //'beam' sits at the mean position of the beam
+  Moments transport(const Particle& beam, const Sigma&, double delta) const;
+
+private:
+  const MagnetSystem& mMagnets;
+  tracking::TrackMode mMode;
+  unsigned mNsteps;
+  double mStepSize;
+  double mScale;
+  float mZcutoff;
+  ApproachReference mReference;
+};
+
+#endif // MOMENTS_H
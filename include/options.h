@@ -0,0 +1,19 @@
+#ifndef OPTIONS_H
+#define OPTIONS_H
+
+#include "./simulation.h"
+#include "./tracking.h"
+#include <boost/program_options.hpp>
+
+namespace po = boost::program_options;
+
+////////////////////////////////////////////
+//options of a run, shared by the command line, the requests of '--serve'
+//and the python bindings
+////////////////////////////////////////////
+po::options_description run_options();
+tracking::TrackMode track_mode(const po::variables_map& vm);
+//settings of one run, with the checks that do not depend on how it is driven (scan, fit, server)
+InputArgs input_args(const po::variables_map& vm);
+
+#endif // OPTIONS_H
@@ -0,0 +1,331 @@
+#ifndef OUTPUT_H
+#define OUTPUT_H
+
+#include <charconv>
+#include <condition_variable>
+#include <deque>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+////////////////////////////////////////////
+//writes filled buffers to a file on a dedicated background thread
+//A fixed number of buffers rotates between the producer and the writer:
+//'acquire' blocks once all of them are queued for writing (back-pressure).
+////////////////////////////////////////////
+class AsyncFileWriter {
+public:
+  using Buffer = std::vector<char>;
+
+  AsyncFileWriter(const std::string& filename, unsigned pNbuffers, std::size_t pBufferSize)
+    : mFile(filename, std::ios_base::out | std::ios_base::binary) {
+    if(!mFile.is_open())
+      throw std::runtime_error("Failed to open " + filename);
+    if(pNbuffers < 2)
+      throw std::invalid_argument("At least two buffers are needed to overlap writing.");
+    for(unsigned i=0; i<pNbuffers; ++i)
+      mFree.emplace_back(pBufferSize);
+    mThread = std::thread(&AsyncFileWriter::loop_, this);
+  }
+
+  ~AsyncFileWriter() {
+    try { close(); }
+    catch(const std::exception& e) { std::cerr << e.what() << std::endl; }
+  }
+
+  AsyncFileWriter(const AsyncFileWriter&) = delete;
+  AsyncFileWriter& operator=(const AsyncFileWriter&) = delete;
+
+  //returns a buffer of the original size; blocks while all buffers are in flight
+  Buffer acquire() {
+    std::unique_lock<std::mutex> lock(mMutex);
+    mCvFree.wait(lock, [this]{ return !mFree.empty() or mFailed; });
+    check_();
+    Buffer b = std::move(mFree.front());
+    mFree.pop_front();
+    return b;
+  }
+
+  //queues the first 'nbytes' of 'b' for writing; the buffer is recycled afterwards
+  void submit(Buffer&& b, std::size_t nbytes) {
+    {
+      std::lock_guard<std::mutex> lock(mMutex);
+      check_();
+      mFilled.emplace_back(std::move(b), nbytes);
+    }
+    mCvFilled.notify_one();
+  }
+
+  //writes everything still queued and stops the background thread
+  void close() {
+    if(!mThread.joinable())
+      return;
+    {
+      std::lock_guard<std::mutex> lock(mMutex);
+      mDone = true;
+    }
+    mCvFilled.notify_one();
+    mThread.join();
+    mFile.close();
+    check_();
+  }
+
+private:
+  std::ofstream mFile;
+  std::thread mThread;
+  std::mutex mMutex;
+  std::condition_variable mCvFree, mCvFilled;
+  std::deque<Buffer> mFree;
+  std::deque<std::pair<Buffer, std::size_t>> mFilled;
+  bool mDone = false;
+  bool mFailed = false;
+
+  void check_() const {
+    if(mFailed)
+      throw std::runtime_error("AsyncFileWriter: writing to disk failed.");
+  }
+
+  void loop_() {
+    while(true) {
+      std::pair<Buffer, std::size_t> item;
+      {
+	std::unique_lock<std::mutex> lock(mMutex);
+	mCvFilled.wait(lock, [this]{ return !mFilled.empty() or mDone; });
+	if(mFilled.empty())
+	  return; //done and drained
+	item = std::move(mFilled.front());
+	mFilled.pop_front();
+      }
+
+      mFile.write(item.first.data(), item.second); //outside the lock
+
+      {
+	std::lock_guard<std::mutex> lock(mMutex);
+	if(!mFile)
+	  mFailed = true;
+	mFree.push_back(std::move(item.first));
+      }
+      mCvFree.notify_one();
+    }
+  }
+};
+
+////////////////////////////////////////////
+//CSV writer formatting with std::to_chars into a reusable buffer
+//Output is byte-compatible with 'std::to_string' (integers and
+//"%f" for floating point) and with "%.<N>f" when a precision is given.
+//Lines end with '\n' and the file is only written in big blocks, either
+//directly or, when 'pNbuffers' > 0, through an AsyncFileWriter. A writer can
+//also fill a stream it does not own (e.g. a socket), flushed with every block.
+////////////////////////////////////////////
+class CSVWriter {
+public:
+  static constexpr std::size_t mDefaultBufferSize = 1 << 20; // 1 MiB
+  static constexpr int mDefaultPrecision = 6; //'std::to_string' uses "%f"
+
+  CSVWriter(const std::string& filename, std::size_t pBufferSize=mDefaultBufferSize,
+	    unsigned pNbuffers=0) {
+    if(pNbuffers > 0) {
+      mAsync = std::make_unique<AsyncFileWriter>(filename, pNbuffers, pBufferSize);
+      mBuffer = mAsync->acquire();
+    }
+    else {
+      mFile.open(filename, std::ios_base::out | std::ios_base::binary);
+      if(!mFile.is_open())
+	throw std::runtime_error("Failed to open " + filename);
+      mBuffer.resize(pBufferSize);
+    }
+  }
+
+  explicit CSVWriter(std::ostream& pStream, std::size_t pBufferSize=mDefaultBufferSize)
+    : mStream(&pStream) {
+    mBuffer.resize(pBufferSize);
+  }
+
+  ~CSVWriter() {
+    try { close(); }
+    catch(const std::exception& e) { std::cerr << e.what() << std::endl; }
+  }
+
+  CSVWriter(const CSVWriter&) = delete;
+  CSVWriter& operator=(const CSVWriter&) = delete;
+
+  //write a header line with the column names
+  void header(const std::vector<std::string>& columns) {
+    for(auto&& c : columns)
+      field(c);
+    end_line();
+  }
+
+  CSVWriter& field(std::string_view s) {
+    separate_();
+    if(s.size() > mBuffer.size() - mPos)
+      flush();
+    if(s.size() > mBuffer.size())
+      throw std::runtime_error("CSVWriter buffer too small for field.");
+    else {
+      s.copy(mBuffer.data() + mPos, s.size());
+      mPos += s.size();
+    }
+    return *this;
+  }
+
+  CSVWriter& field(const std::string& s) { return field(std::string_view(s)); }
+  CSVWriter& field(const char* s) { return field(std::string_view(s)); }
+
+  template <class T>
+  CSVWriter& field(T value) {
+    static_assert(std::is_arithmetic_v<T>, "Only arithmetic values can be formatted.");
+    separate_();
+    if constexpr (std::is_floating_point_v<T>)
+      write_float_(value, mDefaultPrecision);
+    else
+      write_chars_([value](char* b, char* e) { return std::to_chars(b, e, value); });
+    return *this;
+  }
+
+  //fixed notation with 'precision' decimal places, as "%.<precision>f"
+  template <class T>
+  CSVWriter& field(T value, int precision) {
+    static_assert(std::is_floating_point_v<T>, "A precision only applies to floating point values.");
+    separate_();
+    write_float_(value, precision);
+    return *this;
+  }
+
+  CSVWriter& end_line() {
+    if(mPos == mBuffer.size())
+      flush();
+    mBuffer[mPos++] = '\n';
+    mNewLine = true;
+    return *this;
+  }
+
+  //hands the buffered lines to the file (or to the background writer)
+  void flush() {
+    if(mPos == 0)
+      return;
+    if(mAsync) {
+      mAsync->submit(std::move(mBuffer), mPos);
+      mBuffer = mAsync->acquire();
+    }
+    else if(mStream) {
+      mStream->write(mBuffer.data(), mPos);
+      mStream->flush();
+      if(!*mStream)
+	throw std::runtime_error("CSVWriter: writing to the stream failed.");
+    }
+    else
+      mFile.write(mBuffer.data(), mPos);
+    mPos = 0;
+  }
+
+  void close() {
+    if(mAsync) {
+      flush();
+      mAsync->close();
+      mAsync.reset();
+    }
+    else if(mStream) {
+      flush();
+      mStream = nullptr;
+    }
+    else if(mFile.is_open()) {
+      flush();
+      mFile.close();
+    }
+  }
+
+private:
+  std::ofstream mFile;
+  std::unique_ptr<AsyncFileWriter> mAsync;
+  std::ostream* mStream = nullptr; //not owned
+  std::vector<char> mBuffer;
+  std::size_t mPos = 0;
+  bool mNewLine = true;
+
+  void separate_() {
+    if(mNewLine) {
+      mNewLine = false;
+      return;
+    }
+    if(mPos == mBuffer.size())
+      flush();
+    mBuffer[mPos++] = ',';
+  }
+
+  template <class T>
+  void write_float_(T value, int precision) {
+    //'std::to_string' and "%f" promote float to double
+    using P = std::conditional_t<std::is_same_v<T,float>, double, T>;
+    const P v = static_cast<P>(value);
+    write_chars_([v, precision](char* b, char* e) {
+		   return std::to_chars(b, e, v, std::chars_format::fixed, precision);
+		 });
+  }
+
+  //retries once on an empty buffer when the formatted value does not fit
+  template <class F>
+  void write_chars_(F&& conv) {
+    auto res = conv(mBuffer.data() + mPos, mBuffer.data() + mBuffer.size());
+    if(res.ec == std::errc::value_too_large) {
+      flush();
+      res = conv(mBuffer.data(), mBuffer.data() + mBuffer.size());
+      if(res.ec != std::errc())
+	throw std::runtime_error("CSVWriter buffer too small for value.");
+    }
+    mPos = res.ptr - mBuffer.data();
+  }
+};
+
+////////////////////////////////////////////
+//one accepted event of the v1 measurement ('histo' output)
+////////////////////////////////////////////
+struct HistoRecord {
+public:
+  unsigned iBatch;
+  unsigned idx;
+  double sumMomX;
+  double sumMomY;
+  double sumMomZ;
+  float fermiPzBeforeBoost;
+  float fermiPzAfterBoost;
+  float xHitNoBoost;
+  float yHitNoBoost;
+  float xHit;
+  float yHit;
+  float psiA;
+  float psiB;
+  unsigned cat1;
+  float psi;
+  float phi;
+  float eta;
+  float cos;
+
+  static const std::vector<std::string>& columns() {
+    static const std::vector<std::string> c = {"iBatch", "Idx", "sumMomX", "sumMomY", "sumMomZ",
+					       "FermiPzBeforeBoost", "FermiPzAfterBoost",
+					       "XHitNoBoost", "YHitNoBoost", "XHit", "YHit",
+					       "PsiA", "PsiB", "cat1", "Psi", "Phi", "Eta", "Cos"};
+    return c;
+  }
+
+  void write(CSVWriter& w) const {
+    w.field(iBatch).field(idx)
+      .field(sumMomX).field(sumMomY).field(sumMomZ)
+      .field(fermiPzBeforeBoost).field(fermiPzAfterBoost)
+      .field(xHitNoBoost).field(yHitNoBoost).field(xHit).field(yHit)
+      .field(psiA).field(psiB).field(cat1)
+      .field(psi).field(phi).field(eta).field(cos)
+      .end_line();
+  }
+};
+
+#endif // OUTPUT_H
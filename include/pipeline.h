@@ -0,0 +1,199 @@
+#ifndef PIPELINE_H
+#define PIPELINE_H
+
+#include <atomic>
+#include <condition_variable>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+////////////////////////////////////////////
+//bounded lock-free single-producer/single-consumer queue
+//Exactly one thread may push and exactly one thread may pop. The blocking
+//'push' and 'pop' spin briefly and then sleep on a condition variable; the
+//mutex is only taken when the other side is asleep.
+////////////////////////////////////////////
+template <class T>
+class SPSCQueue {
+public:
+  explicit SPSCQueue(std::size_t pCapacity)
+    : mData(round_up_(pCapacity+1)), mMask(mData.size()-1) {}
+
+  SPSCQueue(const SPSCQueue&) = delete;
+  SPSCQueue& operator=(const SPSCQueue&) = delete;
+
+  bool try_push(const T& v) {
+    if(!push_(v))
+      return false;
+    notify_();
+    return true;
+  }
+
+  bool try_pop(T& v) {
+    if(!pop_(v))
+      return false;
+    notify_();
+    return true;
+  }
+
+  //blocking versions; they wait while the queue is full (empty)
+  void push(const T& v) {
+    wait_([&] { return push_(v); });
+    notify_();
+  }
+
+  T pop() {
+    T v;
+    wait_([&] { return pop_(v); });
+    notify_();
+    return v;
+  }
+
+private:
+  std::vector<T> mData;
+  std::size_t mMask;
+  alignas(64) std::atomic<std::size_t> mHead{0}; //consumer side
+  alignas(64) std::atomic<std::size_t> mTail{0}; //producer side
+
+  static constexpr unsigned mSpins = 64; //attempts before sleeping
+  alignas(64) std::mutex mMutex;
+  std::condition_variable mCond;
+  std::atomic<unsigned> mWaiting{0}; //threads asleep on mCond
+
+  bool push_(const T& v) {
+    const std::size_t tail = mTail.load(std::memory_order_relaxed);
+    const std::size_t next = (tail+1) & mMask;
+    if(next == mHead.load(std::memory_order_acquire))
+      return false; //full
+    mData[tail] = v;
+    mTail.store(next, std::memory_order_release);
+    return true;
+  }
+
+  bool pop_(T& v) {
+    const std::size_t head = mHead.load(std::memory_order_relaxed);
+    if(head == mTail.load(std::memory_order_acquire))
+      return false; //empty
+    v = mData[head];
+    mHead.store((head+1) & mMask, std::memory_order_release);
+    return true;
+  }
+
+  //retries 'attempt' until it succeeds, sleeping after 'mSpins' failures
+  template <class F>
+  void wait_(F&& attempt) {
+    for(unsigned i=0; i<mSpins; ++i) {
+      if(attempt())
+	return;
+      std::this_thread::yield();
+    }
+    std::unique_lock<std::mutex> lock(mMutex);
+    mWaiting.fetch_add(1);
+    //pairs with the fence of 'notify_': either the sleeper sees the new index,
+    //or the notifier sees the sleeper
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    mCond.wait(lock, attempt);
+    mWaiting.fetch_sub(1);
+  }
+
+  //wakes the other side after an index update if it is asleep
+  void notify_() {
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if(mWaiting.load(std::memory_order_relaxed) == 0)
+      return;
+    { std::lock_guard<std::mutex> lock(mMutex); }
+    mCond.notify_all();
+  }
+
+  static std::size_t round_up_(std::size_t n) {
+    std::size_t p = 1;
+    while(p < n) p <<= 1;
+    return p;
+  }
+};
+
+////////////////////////////////////////////
+//linear chain of stages, each on its own thread, connected by SPSC queues
+//Work items are pointers taken from a fixed pool: the first stage blocks
+//when every item is in flight, which bounds memory. The last stage runs on
+//the calling thread and recycles the items. A nullptr marks the end of the
+//stream; an exception in any stage stops the pipeline and is rethrown by 'run'.
+////////////////////////////////////////////
+template <class T>
+class Pipeline {
+public:
+  using Stage = std::function<void(T&)>;
+
+  //'source' fills an item and returns false when there is nothing left to produce
+  Pipeline(std::function<bool(T&)> pSource, std::vector<Stage> pStages, Stage pSink)
+    : mSource(pSource), mStages(pStages), mSink(pSink) {}
+
+  void run(std::vector<T>& pool) {
+    const std::size_t nqueues = mStages.size() + 1;
+    std::vector<std::unique_ptr<SPSCQueue<T*>>> queues;
+    for(std::size_t i=0; i<nqueues; ++i)
+      queues.push_back(std::make_unique<SPSCQueue<T*>>(pool.size()));
+    SPSCQueue<T*> recycle(pool.size());
+    for(auto& item : pool)
+      recycle.push(&item);
+
+    //after a failure the stages stop working but keep passing the items on,
+    //so that every thread reaches the end sentinel
+    std::vector<std::thread> threads;
+    threads.emplace_back([&] {
+			   T* item;
+			   while(!mFailed and (item = recycle.pop())) {
+			     bool more = false;
+			     guard_([&] { more = mSource(*item); });
+			     if(!more)
+			       break;
+			     queues[0]->push(item);
+			   }
+			   queues[0]->push(nullptr);
+			 });
+    for(std::size_t s=0; s<mStages.size(); ++s)
+      threads.emplace_back([&, s] {
+			     while(T* item = queues[s]->pop()) {
+			       if(!mFailed)
+				 guard_([&] { mStages[s](*item); });
+			       queues[s+1]->push(item);
+			     }
+			     queues[s+1]->push(nullptr);
+			   });
+
+    while(T* item = queues.back()->pop()) {
+      if(!mFailed)
+	guard_([&] { mSink(*item); });
+      recycle.push(item);
+    }
+
+    for(auto& t : threads)
+      t.join();
+    if(mError)
+      std::rethrow_exception(mError);
+  }
+
+private:
+  std::function<bool(T&)> mSource;
+  std::vector<Stage> mStages;
+  Stage mSink;
+  std::atomic<bool> mFailed{false};
+  std::exception_ptr mError;
+  std::mutex mErrorMutex;
+
+  template <class F>
+  void guard_(F&& f) {
+    try { f(); }
+    catch(...) {
+      std::lock_guard<std::mutex> lock(mErrorMutex);
+      if(!mError)
+	mError = std::current_exception();
+      mFailed = true;
+    }
+  }
+};
+
+#endif // PIPELINE_H
@@ -0,0 +1,83 @@
+#ifndef SERVER_H
+#define SERVER_H
+
+#include "./options.h"
+#include "./simulation.h"
+#include <functional>
+#include <iostream>
+#include <streambuf>
+#include <string>
+#include <vector>
+
+////////////////////////////////////////////
+//listening Unix domain (local) stream socket
+//A socket file left at the path by a previous server is replaced (any other
+//file makes the constructor throw) and the socket is removed on destruction.
+//Several threads can wait in 'accept' on the same server.
+////////////////////////////////////////////
+class UnixServer {
+public:
+  explicit UnixServer(const std::string& pPath, int pBacklog = 64);
+  ~UnixServer();
+
+  UnixServer(const UnixServer&) = delete;
+  UnixServer& operator=(const UnixServer&) = delete;
+
+  //descriptor of the next connection (blocks until a client connects)
+  //With a timeout [s], a read or write of the connection that blocks longer
+  //fails, so that a stalled client cannot hold the thread serving it.
+  int accept(double timeout = 0.) const;
+
+  const std::string& path() const { return mPath; }
+
+private:
+  std::string mPath;
+  int mFd = -1;
+};
+
+////////////////////////////////////////////
+//buffered std::iostream over a connected socket; owns the descriptor
+////////////////////////////////////////////
+class SocketStream : public std::iostream {
+public:
+  explicit SocketStream(int pFd);
+  ~SocketStream();
+
+  SocketStream(const SocketStream&) = delete;
+  SocketStream& operator=(const SocketStream&) = delete;
+
+private:
+  class Buffer : public std::streambuf {
+  public:
+    explicit Buffer(int pFd);
+
+  protected:
+    int_type overflow(int_type c) override;
+    int_type underflow() override;
+    int sync() override;
+
+  private:
+    int mFd;
+    std::vector<char> mIn, mOut;
+
+    bool send_();
+  };
+
+  int mFd;
+  Buffer mBuffer;
+};
+
+////////////////////////////////////////////
+//simulation daemon
+////////////////////////////////////////////
+//context of the runs with the calorimeters and acceptance map of a request (e.g. SharedContexts::get)
+using ContextLookup = std::function<const SharedContext&(const InputArgs&)>;
+
+//runs the request 'line' of a client of 'serve' (its number 'iRequest') and writes the answer to 'conn';
+//returns its status, "done" or the error line sent to the client
+std::string serve_request(const std::string& line, std::ostream& conn, unsigned iRequest,
+			  const po::options_description& desc, unsigned nworkers, const ContextLookup& context);
+
+void serve(const po::options_description& desc, const std::string& path, unsigned nworkers, unsigned trackCache, float timeout);
+
+#endif // SERVER_H
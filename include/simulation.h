@@ -0,0 +1,320 @@
+#ifndef SIMULATION_H
+#define SIMULATION_H
+
+#include "./acceptance.h"
+#include "./dual.h"
+#include "./eventfile.h"
+#include "./fastsim.h"
+#include "./generator.h"
+#include "./flow.h"
+#include "./geometry.h"
+#include "./histogram.h"
+#include "./output.h"
+#include "./summarycache.h"
+#include "./tracking.h"
+#include "./utils.h"
+
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "TFile.h"
+#include "TGraph.h"
+
+struct InputArgs {
+public:
+  bool draw;
+  float x;
+  float y;
+  float energy;
+  float energy_scale;
+  float width_scale;
+  float yshift;
+  float fermi_shift;
+  float mass;
+  float mass_interaction;
+  unsigned npartons;
+  unsigned nparticles;
+  float zcutoff;
+  unsigned mlmc_levels;
+  unsigned mlmc_refinement;
+  float mlmc_tolerance;
+  bool csv_output;
+  bool root_output;
+  bool bin_output;
+  bool histos;
+  unsigned histo_bins;
+  float hit_range;
+  float mom_range;
+  float fermi_range;
+  bool flow;
+  unsigned max_memory;
+  ApproachReference approach;
+  bool zdc;
+  std::string acceptance_map;
+  bool fastsim;
+  unsigned fastsim_nodes;
+  unsigned fastsim_check;
+  unsigned scan_workers;
+  std::string scan_name;
+  unsigned track_cache;
+  unsigned seed;
+  bool moments;
+  bool derivatives;
+  float Bscale;
+  std::string fit_reference;
+  std::string fit_histo;
+};
+
+struct Globals {
+  static constexpr float distanceToDetector = 11600; //cm
+};
+
+float calc_momentum(float en, float mass);
+
+////////////////////////////////////////////
+//distributions of the histo record, filled during the run
+//(what the plotting scripts under python/ compute from the per-event rows)
+//The binning follows '--histo_bins' and the ranges '--hit_range' (hits),
+//'--mom_range' (transverse momentum sums) and '--fermi_range' (Fermi pz);
+//the longitudinal ranges follow the beam energy and the angles are periodic.
+////////////////////////////////////////////
+struct V1Histograms {
+public:
+  //'pSmooth': cloud-in-cell filling (see Histo1D::fill_smooth) of records weighted with their
+  //interaction probability instead of drawn (see 'run'), e.g. for the fits
+  V1Histograms(const InputArgs& args, bool pSmooth=false)
+    : smooth(pSmooth),
+      sumMomX("sumMomX", args.histo_bins, -args.mom_range, args.mom_range),
+      sumMomY("sumMomY", args.histo_bins, -args.mom_range, args.mom_range),
+      sumMomZ("sumMomZ", args.histo_bins, -args.energy/args.npartons, args.energy/args.npartons),
+      fermiPzBeforeBoost("FermiPzBeforeBoost", args.histo_bins, -args.fermi_range, args.fermi_range),
+      fermiPzAfterBoost("FermiPzAfterBoost", args.histo_bins, -2*args.energy, 2*args.energy),
+      xHitNoBoost("XHitNoBoost", args.histo_bins, -args.hit_range, args.hit_range),
+      yHitNoBoost("YHitNoBoost", args.histo_bins, -args.hit_range, args.hit_range),
+      xHit("XHit", args.histo_bins, -args.hit_range, args.hit_range),
+      yHit("YHit", args.histo_bins, -args.hit_range, args.hit_range),
+      psiA("PsiA", args.histo_bins, 0., 2*M_PI),
+      psiB("PsiB", args.histo_bins, 0., 2*M_PI),
+      psi("Psi", args.histo_bins, 0., M_PI),
+      phi("Phi", args.histo_bins, 0., 2*M_PI),
+      eta("Eta", args.histo_bins, -10., 10.),
+      cos("Cos", args.histo_bins, -1., 1.),
+      cat1("cat1", 3, -0.5, 2.5),
+      psiAB("PsiA_PsiB", std::max(args.histo_bins/2, 1u), 0., 2*M_PI, std::max(args.histo_bins/2, 1u), 0., 2*M_PI),
+      hits("XHit_YHit", args.histo_bins, -args.hit_range, args.hit_range, args.histo_bins, -args.hit_range, args.hit_range),
+      hitsNoBoost("XHitNoBoost_YHitNoBoost", args.histo_bins, -args.hit_range, args.hit_range,
+		  args.histo_bins, -args.hit_range, args.hit_range) {}
+
+  void fill(const HistoRecord& r, double w=1.) {
+    if(smooth)
+      fill_(r, [w](Histo1D& h, double x) { h.fill_smooth(x, w); }, [w](Histo2D& h, double x, double y) { h.fill_smooth(x, y, w); });
+    else
+      fill_(r, [w](Histo1D& h, double x) { h.fill(x, w); }, [w](Histo2D& h, double x, double y) { h.fill(x, y, w); });
+  }
+
+  void merge(const V1Histograms& o) {
+    sumMomX.merge(o.sumMomX); sumMomY.merge(o.sumMomY); sumMomZ.merge(o.sumMomZ);
+    fermiPzBeforeBoost.merge(o.fermiPzBeforeBoost); fermiPzAfterBoost.merge(o.fermiPzAfterBoost);
+    xHitNoBoost.merge(o.xHitNoBoost); yHitNoBoost.merge(o.yHitNoBoost);
+    xHit.merge(o.xHit); yHit.merge(o.yHit);
+    psiA.merge(o.psiA); psiB.merge(o.psiB); psi.merge(o.psi);
+    phi.merge(o.phi); eta.merge(o.eta); cos.merge(o.cos); cat1.merge(o.cat1);
+    psiAB.merge(o.psiAB); hits.merge(o.hits); hitsNoBoost.merge(o.hitsNoBoost);
+  }
+
+  void write(const std::string& filename) const {
+    CSVWriter w(filename);
+    w.header(histo_header());
+    for(const Histo1D* h : histos1d())
+      h->write(w);
+    for(const Histo2D* h : histos2d())
+      h->write(w);
+  }
+
+  //contents of the histogram 'name', in the order of its rows in 'write'
+  Vec<double> contents(const std::string& name) const {
+    Vec<double> c;
+    for(const Histo1D* h : histos1d())
+      if(h->name() == name)
+	for(unsigned b=0; b<h->axis().nbins()+2; ++b)
+	  c.push_back(h->content(b));
+    for(const Histo2D* h : histos2d())
+      if(h->name() == name)
+	for(unsigned bx=0; bx<h->xaxis().nbins()+2; ++bx)
+	  for(unsigned by=0; by<h->yaxis().nbins()+2; ++by)
+	    c.push_back(h->content(bx, by));
+    if(c.empty())
+      throw std::invalid_argument("There is no histogram named '" + name + "'.");
+    return c;
+  }
+
+  bool smooth;
+  Histo1D sumMomX, sumMomY, sumMomZ;
+  Histo1D fermiPzBeforeBoost, fermiPzAfterBoost;
+  Histo1D xHitNoBoost, yHitNoBoost, xHit, yHit;
+  Histo1D psiA, psiB, psi, phi, eta, cos, cat1;
+  Histo2D psiAB, hits, hitsNoBoost;
+
+  //every histogram, in the order of 'write'
+  Vec<const Histo1D*> histos1d() const {
+    return {&sumMomX, &sumMomY, &sumMomZ, &fermiPzBeforeBoost, &fermiPzAfterBoost,
+	    &xHitNoBoost, &yHitNoBoost, &xHit, &yHit,
+	    &psiA, &psiB, &psi, &phi, &eta, &cos, &cat1};
+  }
+  Vec<const Histo2D*> histos2d() const { return {&psiAB, &hits, &hitsNoBoost}; }
+
+private:
+  template <class Fill1D, class Fill2D>
+  void fill_(const HistoRecord& r, Fill1D fill1, Fill2D fill2) {
+    fill1(sumMomX, r.sumMomX);
+    fill1(sumMomY, r.sumMomY);
+    fill1(sumMomZ, r.sumMomZ);
+    fill1(fermiPzBeforeBoost, r.fermiPzBeforeBoost);
+    fill1(fermiPzAfterBoost, r.fermiPzAfterBoost);
+    fill1(xHitNoBoost, r.xHitNoBoost);
+    fill1(yHitNoBoost, r.yHitNoBoost);
+    fill1(xHit, r.xHit);
+    fill1(yHit, r.yHit);
+    fill1(psiA, r.psiA);
+    fill1(psiB, r.psiB);
+    fill1(psi, r.psi);
+    fill1(phi, r.phi);
+    fill1(eta, r.eta);
+    fill1(cos, r.cos);
+    fill1(cat1, r.cat1);
+    fill2(psiAB, r.psiA, r.psiB);
+    fill2(hits, r.xHit, r.yHit);
+    fill2(hitsNoBoost, r.xHitNoBoost, r.yHitNoBoost);
+  }
+};
+
+////////////////////////////////////////////
+//front end that draws a run with '--draw' (EveDisplay in display.h)
+//The library only hands it the geometry and the full trajectories, so that
+//it needs no graphics library itself.
+////////////////////////////////////////////
+class TrackDisplay {
+public:
+  virtual ~TrackDisplay() = default;
+
+  virtual void geometry(const MagnetSystem&, const CaloSystem&, float zcutoff) = 0;
+  //trajectories of a batch; pairs with 'drawn' false were not tracked
+  virtual void tracks(const Vec<Track>& tracks1, const Vec<Track>& tracks2, const Vec<unsigned char>& drawn) = 0;
+  //once the run is over
+  virtual void show() = 0;
+};
+
+////////////////////////////////////////////
+//inputs that do not depend on the configuration, read once per process
+//and shared (read-only) by every configuration of a scan
+////////////////////////////////////////////
+struct SharedContext {
+public:
+  explicit SharedContext(const InputArgs& args);
+
+  //keeps the tracks of the runs in a SummaryCache of 'megabytes' MB (none for 0)
+  void cache_tracks(unsigned megabytes);
+
+  MagnetSystem magnets;
+  CaloSystem calos;
+  std::unique_ptr<TFile> graphFile;
+  TGraph* graph; //owned by graphFile
+  double xmin = 1e10, xmax = -1e10;
+  std::unique_ptr<AcceptanceMap> acceptance;
+  std::unique_ptr<SummaryCache> tracks; //tracks reused by the configurations of a scan
+  std::unique_ptr<TrackTableCache> tables; //tables of '--fastsim' reused across runs
+  std::shared_ptr<const CumulativeTable> boltzmann, fermi; //sampled by the generators of every run
+  TrackDisplay* display = nullptr; //draws the runs with '--draw'; none in the headless executable
+};
+
+////////////////////////////////////////////
+//contexts of the runs of a long-lived process (server, python bindings)
+//One per calorimeter setting and acceptance map, built by the first run that
+//needs it (with a track cache of 'pTrackCache' MB) and kept for the next ones.
+//Several threads can get contexts at once.
+////////////////////////////////////////////
+class SharedContexts {
+public:
+  explicit SharedContexts(unsigned pTrackCache) : mTrackCache(pTrackCache) {}
+
+  const SharedContext& get(const InputArgs& args);
+
+private:
+  unsigned mTrackCache;
+  std::mutex mMutex;
+  std::map<std::pair<bool, std::string>, std::unique_ptr<SharedContext>> mContexts;
+};
+
+////////////////////////////////////////////
+//single output of a scan: the 'histo' rows of every configuration, with the
+//index of their configuration, and one row per configuration in the index
+////////////////////////////////////////////
+struct ScanOutput {
+public:
+  std::mutex mutex; //the configurations run on different threads
+  std::unique_ptr<CSVWriter> histo;
+  Vec<std::pair<unsigned, std::string>> index; //(configuration, row), sorted when written
+};
+
+////////////////////////////////////////////
+//results of a run kept in memory instead of being written, for the callers
+//that use them directly (fits, python bindings); null members are not filled
+//A run with results prints nothing and writes no file.
+////////////////////////////////////////////
+struct RunResults {
+public:
+  V1Histograms* histos = nullptr;
+  HistoColumns* records = nullptr; //the 'histo' rows
+  FlowAccumulator* flow = nullptr;
+};
+
+////////////////////////////////////////////
+//simulation modes, one configuration each
+////////////////////////////////////////////
+//sampled pairs; 'scan' collects the outputs of a scan instead of the per-run files
+void run(tracking::TrackMode mode, const InputArgs& args, const SharedContext& ctx,
+	 ScanOutput* scan = nullptr, unsigned iScan = 0, RunResults* results = nullptr);
+
+//quantities of '--moments' and '--derivatives', in the order of their outputs
+const Vec<std::string>& moment_quantities();
+
+//transported beam moments
+void run_moments(tracking::TrackMode mode, const InputArgs& args, const SharedContext& ctx,
+		 ScanOutput* scan = nullptr, unsigned iScan = 0);
+
+namespace derivatives {
+  enum Parameter { X=0, Y, YShift, WidthScale, Bscale, NPARS };
+  using D = Dual<NPARS>;
+
+  const Vec<std::string>& parameters();
+}
+
+//mean quantities of the sampled pairs with their derivatives
+void run_derivatives(tracking::TrackMode mode, const InputArgs& args, const SharedContext& ctx,
+		     ScanOutput* scan = nullptr, unsigned iScan = 0);
+
+////////////////////////////////////////////
+//parameter scans in a single process
+////////////////////////////////////////////
+void set_parameter(InputArgs& args, const std::string& name, double value);
+Vec<InputArgs> scan_configurations(const InputArgs& base, const Vec<std::string>& specs, const std::string& filename);
+std::string scan_index_header(bool flow, bool moments, bool derivatives);
+void run_scan(tracking::TrackMode mode, const InputArgs& args, Vec<InputArgs> configs);
+
+////////////////////////////////////////////
+//fits of the beam parameters to a reference distribution
+////////////////////////////////////////////
+//contents of the histogram 'name' in a file in the format of V1Histograms::write, in the order of its rows
+Vec<double> read_histogram(const std::string& filename, const std::string& name);
+//chi2 of the shape of 'sim', normalised to the entries of 'ref', with the errors of both
+double shape_chi2(const Vec<double>& ref, const Vec<double>& sim);
+void run_fit(tracking::TrackMode mode, const InputArgs& args, const Vec<std::string>& names);
+
+//multilevel Monte Carlo estimate of the mean PsiA
+void run_mlmc(tracking::TrackMode mode, const InputArgs& args, const SharedContext& ctx);
+
+#endif // SIMULATION_H
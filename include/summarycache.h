@@ -0,0 +1,60 @@
+#ifndef SUMMARYCACHE_H
+#define SUMMARYCACHE_H
+
+#include "./geometry.h"
+#include "./tracking.h"
+#include <array>
+#include <atomic>
+#include <future>
+#include <list>
+#include <mutex>
+#include <unordered_map>
+
+////////////////////////////////////////////
+//tracking outcomes shared by the runs that track the same particles
+//The TrackSummary of every tracked particle is kept under the inputs of the
+//tracking (mode, number of steps, step size, field scale, zcutoff, closest
+//approach reference and initial state) for one magnet system, so that the
+//configurations of a scan which only differ after the tracking (fermi_shift,
+//mass_interaction, ...) never track a particle twice. Without any field the
+//trajectory does not depend on |p|: the momentum enters the key as a direction
+//and the cached momenta are rescaled.
+//Safe to share between threads: a particle being tracked by one run is waited
+//for by the runs that need it at the same time instead of being tracked again.
+//Beyond 'capacity' summaries, the least recently used one is dropped.
+////////////////////////////////////////////
+class SummaryCache {
+public:
+  //memory of one entry, including the nodes of the hash table and of the LRU list
+  //and the shared state of its future (approximate)
+  static constexpr std::size_t mEntrySize = 19*sizeof(double) + sizeof(TrackSummary) + 14*sizeof(void*);
+
+  SummaryCache(const MagnetSystem& pMagnets, std::size_t pCapacity);
+
+  //same outcome as 'particle.summarize(magnets, mode, scale, zcutoff)'
+  TrackSummary summarize(const SimParticle&, tracking::TrackMode, double, float);
+
+  std::size_t size() const;
+  unsigned long hits() const { return mHits; }
+  unsigned long misses() const { return mMisses; }
+
+private:
+  using Key = std::array<double,19>;
+  struct KeyHash {
+    std::size_t operator()(const Key&) const;
+  };
+
+  struct Entry {
+    std::shared_future<TrackSummary> summary; //ready once tracked
+    std::list<const Key*>::iterator lru;
+  };
+
+  const MagnetSystem& mMagnets;
+  std::size_t mCapacity;
+  mutable std::mutex mMutex;
+  std::unordered_map<Key, Entry, KeyHash> mSummaries;
+  std::list<const Key*> mLru; //keys of mSummaries, most recently used first
+  std::atomic<unsigned long> mHits{0}, mMisses{0};
+};
+
+#endif // SUMMARYCACHE_H
@@ -71,7 +71,7 @@ public:
 };
 
 // -------------------- progress_bar --------------------
-void clamp(double& x, double a, double b)
+inline void clamp(double& x, double a, double b)
 {
     if (x < a) x = a;
     if (x > b) x = b;
@@ -570,7 +570,7 @@ private:
     progress_bar bar_;
 };
 
-auto tqdm(timer t)
+inline auto tqdm(timer t)
 {
     return tqdm_timer(t.num_seconds);
 }
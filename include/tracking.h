@@ -2,10 +2,16 @@
 #define TRACKING_H
 
 //#include "./functions.h"
+#include "./dual.h"
 #include "./geometry.h"
 #include "./utils.h"
+#include <array>
 #include <memory>
 #include <cmath>
+#include <limits>
+#include <optional>
+#include <stdexcept>
+#include <type_traits>
 
 #include "TROOT.h"
 #include "Math/Vector3D.h" // XYZVector
@@ -13,6 +19,20 @@
 
 namespace tracking {
   enum TrackMode { Euler=0, RungeKutta4, NMODES };
+
+  //stepping of the v1_beam runs: the euler mode spans the fake deflection at
+  //'zcutoff' in 500 steps, RK4 uses 1 cm steps
+  struct StepSettings {
+  public:
+    unsigned nsteps;
+    double stepsize; //cm
+  };
+
+  inline StepSettings step_settings(TrackMode mode, float zcutoff) {
+    if(mode == Euler)
+      return {30000, static_cast<double>(zcutoff)/500.};
+    return {13000, 1.};
+  }
 }
 
 ////////////////////////////////////////////
@@ -27,6 +47,101 @@ public:
   int charge;
 };
 
+////////////////////////////////////////////
+//point or line to which the closest approach of a track is measured
+////////////////////////////////////////////
+class ApproachReference {
+public:
+  using XYZ = ROOT::Math::XYZVector;
+
+  //the interaction point, (0,0,0)
+  ApproachReference() : mPoint(0., 0., 0.), mDir(0., 0., 0.) {}
+
+  static ApproachReference point(const XYZ& p) { return ApproachReference(p, XYZ(0., 0., 0.)); }
+  static ApproachReference line(const XYZ& p, const XYZ& dir) {
+    if(dir.Mag2() == 0.)
+      throw std::invalid_argument("The direction of the reference line cannot be null.");
+    return ApproachReference(p, dir.Unit());
+  }
+
+  const XYZ& origin() const { return mPoint; }
+  const XYZ& direction() const { return mDir; }
+  //unchanged by the reflection z -> -z
+  bool mirror_symmetric() const {
+    if(mDir.Mag2() == 0.)
+      return mPoint.Z() == 0.;
+    return (mDir.X() == 0. and mDir.Y() == 0.) or (mDir.Z() == 0. and mPoint.Z() == 0.);
+  }
+
+  //vector from the reference to 'p' (perpendicular to the line, if any)
+  XYZ separation(const XYZ& p) const {
+    XYZ d = p - mPoint;
+    return d - d.Dot(mDir) * mDir;
+  }
+
+private:
+  XYZ mPoint;
+  XYZ mDir; //unit vector; null for a point
+
+  ApproachReference(const XYZ& pPoint, const XYZ& pDir) : mPoint(pPoint), mDir(pDir) {}
+};
+
+////////////////////////////////////////////
+//closest approach of a track, interpolated within the step where it happens
+////////////////////////////////////////////
+struct ClosestApproach {
+public:
+  using XYZ = ROOT::Math::XYZVector;
+
+  double distance = std::numeric_limits<double>::infinity();
+  double step = 0.; //fractional step index
+  XYZ pos;
+  XYZ mom;
+};
+
+////////////////////////////////////////////
+//quantities of a track needed by the analysis, accumulated while stepping
+//(the trajectory itself is never stored)
+////////////////////////////////////////////
+struct TrackSummary {
+public:
+  using XYZ = ROOT::Math::XYZVector;
+
+  unsigned nStepsUsed = 0;
+  XYZ lastPos; //last stored step, as in 'Track::positions().back()'
+  XYZ lastMom;
+  ClosestApproach closest;
+};
+
+//reflection z -> -z: in a mirror symmetric field (see MagnetSystem::mirror_symmetric), the track
+//of the reflected particle is the reflection of the track of the particle
+inline Particle mirror_z(Particle p) {
+  p.pos.SetZ(-p.pos.Z());
+  p.mom.SetZ(-p.mom.Z());
+  return p;
+}
+inline TrackSummary mirror_z(TrackSummary s) {
+  for(ROOT::Math::XYZVector* v : {&s.lastPos, &s.lastMom, &s.closest.pos, &s.closest.mom})
+    v->SetZ(-v->Z());
+  return s;
+}
+
+////////////////////////////////////////////
+//end of a track with its derivatives with respect to the initial x, y, px and
+//py and to the field scale (forward-mode differentiation of the stepping)
+//The number of steps is not differentiated: the derivatives are those of the
+//last step for a fixed number of steps.
+////////////////////////////////////////////
+struct TrackGradient {
+public:
+  enum Parameter { X=0, Y, PX, PY, SCALE, NPARS };
+  using D = Dual<NPARS>;
+
+  unsigned nStepsUsed = 0;
+  Vec3<D> lastPos;
+  Vec3<D> lastMom;
+};
+
 ////////////////////////////////////////////
 //simple structure to store track information
 ////////////////////////////////////////////
@@ -39,24 +154,34 @@ public:
  Track(): mNstepsUsed(0), mEnergies(0), mPositions(0), mMomenta(0) {};
   
   Track(unsigned pNstepsUsed,
-	Vec<double> pEnergies, Vec<XYZ> pPositions, Vec<XYZ> pMomenta)
+	Vec<double> pEnergies, Vec<XYZ> pPositions, Vec<XYZ> pMomenta,
+	ClosestApproach pClosest = ClosestApproach())
     : mNstepsUsed(pNstepsUsed),
-    mEnergies(pEnergies), mPositions(pPositions), mMomenta(pMomenta) {};
+    mEnergies(std::move(pEnergies)), mPositions(std::move(pPositions)), mMomenta(std::move(pMomenta)),
+    mClosest(pClosest) {};
 
   unsigned steps_used() const { return mNstepsUsed; }
-  Vec<double> energies() const { return mEnergies; }
-  Vec<XYZ> positions() const { return mPositions; }
-  Vec<XYZ> momenta() const { return mMomenta; }
+  const Vec<double>& energies() const { return mEnergies; }
+  const Vec<XYZ>& positions() const { return mPositions; }
+  const Vec<XYZ>& momenta() const { return mMomenta; }
+  const ClosestApproach& closest_approach() const { return mClosest; }
+
+  //the same summary the streaming tracker produces
+  TrackSummary summary() const;
   
 private:
   unsigned mNstepsUsed;
   Vec<double> mEnergies;
   Vec<XYZ> mPositions;
   Vec<XYZ> mMomenta;
+  ClosestApproach mClosest;
 };
 
 ////////////////////////////////////////////
 //simulates the particle trajectory
+//A small record (initial state and stepping configuration) that owns no
+//memory. Its moves cannot throw, so vectors of millions of them relocate
+//by moving instead of copying. Results are not cached: see TrackCache.
 ////////////////////////////////////////////
 class SimParticle {
 public:
@@ -66,36 +191,73 @@ public:
   using Ltz = ROOT::Math::PxPyPzMVector;
 
   SimParticle(Particle pParticle)
-    : mParticle(pParticle),
-      mTracks(tracking::TrackMode::NMODES), mTrackCheck(tracking::TrackMode::NMODES, false) {}
+    : mParticle(pParticle) {}
   
-  SimParticle(Particle pParticle, unsigned pNsteps, double pStepSize)
+  SimParticle(Particle pParticle, unsigned pNsteps, double pStepSize,
+	      ApproachReference pReference = ApproachReference())
     : mParticle(pParticle),
-      mTracks(tracking::TrackMode::NMODES), mTrackCheck(tracking::TrackMode::NMODES, false),
-      mNsteps(pNsteps), mStepSize(pStepSize) {};
+      mNsteps(pNsteps), mStepSize(pStepSize), mReference(pReference) {};
 
-  const Track& track(const MagnetSystem&, tracking::TrackMode, double, float) &;
-  //no copies of big objects, so forbid calling 'track()' on a temporary object
+  Track track(const MagnetSystem&, tracking::TrackMode, double, float) const;
+
+  //streaming alternative to 'track()': the steps are reduced on the fly and never stored
+  TrackSummary summarize(const MagnetSystem&, tracking::TrackMode, double, float) const;
+
+  //same stepping as 'summarize()', carrying the derivatives along
+  TrackGradient differentiate(const MagnetSystem&, tracking::TrackMode, double, float) const;
   
   //temporary, doesnt follow class approach
   Track track_straight(); 
-  Track track(const MagnetSystem&, tracking::TrackMode, double) && = delete;
-  //Track track_straight() && = delete;
+
+  const Particle& particle() const { return mParticle; }
+  unsigned nsteps() const { return mNsteps; }
+  double step_size() const { return mStepSize; }
+  const ApproachReference& reference() const { return mReference; }
     
 private:
   Particle mParticle;
-  Vec<Track> mTracks;
-  Vec<bool> mTrackCheck;
   
   static constexpr double mSpeedOfLight = 29979245800.0; // (cm/s)
   static constexpr double mEcharge = 1.602176565E-19; // C = A*s
   unsigned mNsteps = 3000;
   double mStepSize = 0.;
+  ApproachReference mReference; //closest approach of the tracks
+
+  //the stepping is templated on the scalar type: double, or Dual for the derivatives
+  template <class T>
+  Vec3<T> calc_relativistic_velocity(const Vec3<T>&, const T&, double) const;
+  template <class T>
+  Vec3<T> calc_lorentz_force(double, const Vec3<T>&, const Vec3<T>&) const;
+  template <class T>
+  T gamma_(const Vec3<T>&) const;
+  template <class T>
+  T beta_(const Vec3<T>&) const;
+  //the steppers hand every step to a 'Recorder' (full trajectory, summary or gradient)
+  template <class T, class Recorder>
+  unsigned track_euler( const Vec3<T>&, const Vec3<T>&, const MagnetSystem&, const T&, float, Recorder& ) const;
+  template <class T, class Recorder>
+  unsigned track_rungekutta4( const Vec3<T>&, const Vec3<T>&, const MagnetSystem&, const T&, Recorder& ) const;
+};
+
+static_assert(std::is_nothrow_move_constructible_v<SimParticle>);
+
+////////////////////////////////////////////
+//opt-in caching of the tracks of one particle, one per TrackMode
+//Useful when the same particle is tracked several times (e.g. comparing modes).
+////////////////////////////////////////////
+class TrackCache {
+public:
+  explicit TrackCache(SimParticle pParticle) : mParticle(pParticle) {}
 
-  XYZ calc_relativistic_velocity(const XYZ&, double, double) const;
-  XYZ calc_lorentz_force(double, const XYZ&, const XYZ&) const;
-  Track track_euler( const MagnetSystem&, double, float );
-  Track track_rungekutta4( const MagnetSystem&, double );
+  const Track& track(const MagnetSystem&, tracking::TrackMode, double, float) &;
+  //no copies of big objects, so forbid calling 'track()' on a temporary object
+  const Track& track(const MagnetSystem&, tracking::TrackMode, double, float) && = delete;
+
+  const SimParticle& particle() const { return mParticle; }
+
+private:
+  SimParticle mParticle;
+  std::array<std::optional<Track>, tracking::TrackMode::NMODES> mTracks;
 };
 
 #endif // TRACKING_H
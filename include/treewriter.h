@@ -0,0 +1,39 @@
+#ifndef TREEWRITER_H
+#define TREEWRITER_H
+
+#include "./output.h"
+#include <memory>
+#include <string>
+
+#include "TFile.h"
+#include "TTree.h"
+
+////////////////////////////////////////////
+//columnar ROOT output of the 'histo' record
+//Baskets are compressed in parallel when ROOT's implicit
+//multi-threading is enabled (see 'enable_implicit_mt'). The tree
+//flushes them itself once mAutoFlushBytes have been filled.
+////////////////////////////////////////////
+class TreeWriter {
+public:
+  TreeWriter(const std::string&, const std::string& treename="histo");
+  ~TreeWriter();
+
+  TreeWriter(const TreeWriter&) = delete;
+  TreeWriter& operator=(const TreeWriter&) = delete;
+
+  void fill(const HistoRecord&);
+  void close();
+
+  static void enable_implicit_mt(unsigned nthreads=0);
+  
+private:
+  //uncompressed bytes filled between two flushes of the baskets (large baskets compress best)
+  static constexpr Long64_t mAutoFlushBytes = 32 << 20;
+
+  std::unique_ptr<TFile> mFile;
+  TTree* mTree; //owned by mFile
+  HistoRecord mRecord; //branch addresses point here
+};
+
+#endif // TREEWRITER_H
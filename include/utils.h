@@ -51,16 +51,6 @@ inline std::pair<float,float> calculate_angles_to_beamline(float x, float y, flo
   return p;
 }
 
-inline unsigned get_index_closer_to_origin(const std::vector<XYZ>& pos, unsigned nitems) {
-  float distance;
-  for(unsigned i_step = 0; i_step<nitems; i_step++) {
-    distance = TMath::Sqrt( pos[i_step].Mag2() );
-    if(distance < TMath::Sqrt( pos[i_step+1].Mag2() ) and fabs(pos[i_step].Z()) < 10.)
-      return i_step;
-  }
-  return nitems-1;
-}
-
 inline float distance_two_angles(float a1, float a2) {
   /*calculates the angle ("distance") between two angles,
     avoiding the boundary condition issues (the sum of two uniform
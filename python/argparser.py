@@ -44,6 +44,12 @@ def add_args(parser, mode):
             help='Shifts in the Y axis applied to the fermi distribution [MeV]',
         )
 
+        parser.add_argument(
+            '--binary',
+            action='store_true',
+            help='Read the binary event files (v1_beam.exe --output bin) instead of the CSV files'
+        )
+
         parser.add_argument(
             '--mode',
             type=str,
@@ -0,0 +1,274 @@
+#include "include/generator.h"
+#include "include/lattice.h"
+#include "include/options.h"
+#include "include/simulation.h"
+#include "include/tracking.h"
+
+#include <array>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <pybind11/pybind11.h>
+#include <pybind11/numpy.h>
+#include <pybind11/stl.h>
+
+#include "TROOT.h"
+
+namespace py = pybind11;
+
+////////////////////////////////////////////
+//python module 'directflow', built with 'make python'
+//The arrays it returns are views over the C++ buffers (no copy): each array
+//keeps alive the object that owns its memory, so they outlive the call.
+////////////////////////////////////////////
+namespace {
+  using Point = std::array<double,3>;
+
+  XYZ xyz(const Point& p) { return XYZ(p[0], p[1], p[2]); }
+  Point point(const XYZ& v) { return Point{{v.X(), v.Y(), v.Z()}}; }
+
+  //capsule that deletes 'p' once the last array viewing it is gone
+  template <class T>
+  py::capsule owner(std::unique_ptr<T> p) {
+    return py::capsule(p.release(), [](void* q) { delete static_cast<T*>(q); });
+  }
+
+  //(n, 3) view of three-vectors (an XYZVector is stored as its three doubles)
+  py::array xyz_view(const Vec<XYZ>& v, py::handle base) {
+    static_assert(sizeof(XYZ) == 3*sizeof(double), "XYZVector is expected to hold its three coordinates only");
+    return py::array_t<double>({v.size(), std::size_t(3)}, {sizeof(XYZ), sizeof(double)},
+			       reinterpret_cast<const double*>(v.data()), base);
+  }
+
+  //bin edges of an axis, under/overflow excluded
+  py::array_t<double> edges(const Axis& a) {
+    py::array_t<double> e(a.nbins() + 1);
+    auto w = e.mutable_unchecked<1>();
+    for(unsigned b=1; b<=a.nbins(); ++b)
+      w(b-1) = a.low_edge(b);
+    w(a.nbins()) = a.high_edge(a.nbins());
+    return e;
+  }
+
+  //the 'histo' rows as {column: array}, in the dtypes of EventFile
+  py::dict records_dict(std::unique_ptr<HistoColumns> c) {
+    const HistoColumns& cols = *c;
+    const py::capsule base = owner(std::move(c));
+    py::dict d;
+    cols.for_each_column([&](const std::string& name, const char* dtype, const void* data, std::size_t size) {
+			   d[name.c_str()] = py::array(py::dtype(dtype), {cols.size()}, {size}, data, base);
+			 });
+    return d;
+  }
+
+  //{name: {"contents", "edges"}} for 1D and {name: {"contents", "xedges", "yedges"}} for 2D histograms;
+  //the contents include the under/overflow bins, as in V1Histograms::write
+  py::dict histos_dict(std::unique_ptr<V1Histograms> h) {
+    const V1Histograms& hs = *h;
+    const py::capsule base = owner(std::move(h));
+    py::dict d;
+    for(const Histo1D* h1 : hs.histos1d()) {
+      py::dict e;
+      e["contents"] = py::array_t<double>({h1->contents().size()}, {sizeof(double)}, h1->contents().data(), base);
+      e["edges"] = edges(h1->axis());
+      d[h1->name().c_str()] = e;
+    }
+    for(const Histo2D* h2 : hs.histos2d()) {
+      const std::size_t nx = h2->xaxis().nbins() + 2, ny = h2->yaxis().nbins() + 2;
+      py::dict e;
+      e["contents"] = py::array_t<double>({nx, ny}, {ny*sizeof(double), sizeof(double)}, h2->contents().data(), base);
+      e["xedges"] = edges(h2->xaxis());
+      e["yedges"] = edges(h2->yaxis());
+      d[h2->name().c_str()] = e;
+    }
+    return d;
+  }
+
+  //command line tokens of keyword arguments: '--name value', or '--name' for a true flag
+  std::vector<std::string> tokens(const py::kwargs& kw) {
+    std::vector<std::string> t;
+    for(const auto& item : kw) {
+      const std::string name = "--" + py::str(item.first).cast<std::string>();
+      if(py::isinstance<py::bool_>(item.second)) {
+	if(item.second.cast<bool>())
+	  t.push_back(name);
+      }
+      else {
+	t.push_back(name);
+	t.push_back(py::str(item.second).cast<std::string>());
+      }
+    }
+    return t;
+  }
+
+  //as in the server, kept for the next calls (with the track cache of the first one)
+  const SharedContext& context(const InputArgs& a) {
+    static SharedContexts contexts(a.track_cache);
+    return contexts.get(a);
+  }
+
+  py::dict run_py(const py::kwargs& kw) {
+    /*
+      One configuration of v1_beam.exe, with its options as keyword arguments
+      (run(x=0.08, y=0.08, energy=1380, nparticles=10000, flow=True)). Returns the
+      'histo' rows, the histograms and, with flow=True, the flow estimators, instead
+      of writing them. The geometry and the interaction graph are read once per process.
+    */
+    const po::options_description desc = run_options();
+    po::variables_map vm;
+    po::store(po::command_line_parser(tokens(kw)).options(desc).run(), vm);
+    po::notify(vm);
+    const tracking::TrackMode mode = track_mode(vm);
+    const InputArgs args = input_args(vm);
+    if(args.draw or args.moments or args.derivatives or args.mlmc_levels > 0 or vm.count("scan")
+       or !boost::any_cast<std::string>(vm["scan_file"].value()).empty()
+       or boost::any_cast<bool>(vm["fit"].value()) or vm.count("serve"))
+      throw std::invalid_argument("The bindings run one sampled configuration: 'draw', 'moments', 'derivatives', 'mlmc_levels', 'fit', scans and 'serve' are not supported.");
+
+    auto histos = std::make_unique<V1Histograms>(args);
+    auto records = std::make_unique<HistoColumns>();
+    FlowAccumulator flow;
+    {
+      py::gil_scoped_release release;
+      RunResults results;
+      results.histos = histos.get();
+      results.records = records.get();
+      results.flow = args.flow ? &flow : nullptr;
+      run(mode, args, context(args), nullptr, 0, &results);
+    }
+
+    py::dict d;
+    d["records"] = records_dict(std::move(records));
+    d["histos"] = histos_dict(std::move(histos));
+    if(args.flow) {
+      py::dict f;
+      for(const auto& e : {std::make_pair("v1EP", flow.v1_ep()), std::make_pair("v1SP", flow.v1_sp())})
+	f[e.first] = py::make_tuple(e.second.value, e.second.error);
+      d["flow"] = f;
+    }
+    return d;
+  }
+
+  //'generate' and 'sample(n)' (into a new array) of a generator
+  template <class G, class T>
+  void bind_generator(py::class_<G>& c) {
+    c.def("generate", &G::generate)
+      .def("sample", [](G& g, std::size_t n) {
+		       py::array_t<T> a(n);
+		       auto w = a.template mutable_unchecked<1>();
+		       for(std::size_t i=0; i<n; ++i)
+			 w(i) = g.generate();
+		       return a;
+		     }, py::arg("n"));
+  }
+}
+
+PYBIND11_MODULE(directflow, m) {
+  m.doc() = "Tracking of the spectators and v1 simulation of DirectFlow";
+  ROOT::EnableThreadSafety(); //the runs start their own threads
+
+  py::enum_<tracking::TrackMode>(m, "TrackMode")
+    .value("Euler", tracking::TrackMode::Euler)
+    .value("RungeKutta4", tracking::TrackMode::RungeKutta4);
+
+  py::class_<Particle>(m, "Particle")
+    .def(py::init([](const Point& pos, const Point& mom, double energy, double mass, int charge) {
+		    return Particle{xyz(pos), xyz(mom), energy, mass, charge};
+		  }),
+      py::arg("pos"), py::arg("mom"), py::arg("energy"), py::arg("mass"), py::arg("charge") = 1)
+    .def_property("pos", [](const Particle& p) { return point(p.pos); }, [](Particle& p, const Point& v) { p.pos = xyz(v); })
+    .def_property("mom", [](const Particle& p) { return point(p.mom); }, [](Particle& p, const Point& v) { p.mom = xyz(v); })
+    .def_readwrite("energy", &Particle::energy)
+    .def_readwrite("mass", &Particle::mass)
+    .def_readwrite("charge", &Particle::charge);
+
+  py::class_<ApproachReference>(m, "ApproachReference")
+    .def(py::init<>())
+    .def_static("point", [](const Point& p) { return ApproachReference::point(xyz(p)); })
+    .def_static("line", [](const Point& p, const Point& dir) { return ApproachReference::line(xyz(p), xyz(dir)); });
+
+  //the z ends of a quadrupole are given from the larger one (its field is off otherwise)
+  py::class_<Magnet> magnet(m, "Magnet");
+  py::enum_<Magnet::Type>(magnet, "Type")
+    .value("DipoleX", Magnet::DipoleX)
+    .value("DipoleY", Magnet::DipoleY)
+    .value("Quadrupole", Magnet::Quadrupole);
+  magnet.def(py::init([](Magnet::Type type, std::pair<double,double> intensity, const Point& begin, const Point& end,
+			 const std::string& label) {
+			return Magnet{type, label, 0, intensity, Dimensions{begin[0], end[0], begin[1], end[1], begin[2], end[2]}};
+		      }),
+	     py::arg("type"), py::arg("intensity"), py::arg("begin"), py::arg("end"), py::arg("label") = "",
+	     "magnet with the field 'intensity' (Bx, By) [T] in the box from 'begin' to 'end' [cm]")
+    .def_readwrite("type", &Magnet::type)
+    .def_readwrite("label", &Magnet::label)
+    .def_readwrite("intensity", &Magnet::intensity)
+    .def_property_readonly("begin", [](const Magnet& mg) { return point(mg.dims.beg); })
+    .def_property_readonly("end", [](const Magnet& mg) { return point(mg.dims.end); });
+
+  py::class_<MagnetSystem>(m, "MagnetSystem")
+    .def(py::init<const std::vector<Magnet>&>(), py::arg("magnets"))
+    .def("field", [](const MagnetSystem& ms, py::array_t<double, py::array::c_style | py::array::forcecast> pos, double scale) {
+		    if(pos.ndim() != 2 or pos.shape(1) != 3)
+		      throw std::invalid_argument("The positions must be an (n, 3) array.");
+		    auto r = pos.unchecked<2>();
+		    py::array_t<double> b({static_cast<std::size_t>(pos.shape(0)), std::size_t(3)});
+		    auto w = b.mutable_unchecked<2>();
+		    for(py::ssize_t i=0; i<r.shape(0); ++i) {
+		      const XYZ f = ms.field(XYZ(r(i,0), r(i,1), r(i,2)), scale);
+		      w(i,0) = f.X(); w(i,1) = f.Y(); w(i,2) = f.Z();
+		    }
+		    return b;
+		  }, py::arg("pos"), py::arg("scale") = 1., "field [T] at the (n, 3) positions [cm]")
+    .def("field_free", &MagnetSystem::field_free, py::arg("scale") = 1.)
+    .def("mirror_symmetric", &MagnetSystem::mirror_symmetric);
+  m.def("magnet_lattice", [] { return MagnetSystem(magnet_lattice()); }, "the magnets of v1_beam.exe");
+
+  py::class_<TrackSummary>(m, "TrackSummary")
+    .def_readonly("nsteps_used", &TrackSummary::nStepsUsed)
+    .def_property_readonly("last_pos", [](const TrackSummary& s) { return point(s.lastPos); })
+    .def_property_readonly("last_mom", [](const TrackSummary& s) { return point(s.lastMom); })
+    .def_property_readonly("closest_pos", [](const TrackSummary& s) { return point(s.closest.pos); })
+    .def_property_readonly("closest_mom", [](const TrackSummary& s) { return point(s.closest.mom); })
+    .def_property_readonly("closest_distance", [](const TrackSummary& s) { return s.closest.distance; });
+
+  //the trajectories are views over the steps of the Track
+  py::class_<Track>(m, "Track")
+    .def_property_readonly("steps_used", &Track::steps_used)
+    .def_property_readonly("positions", [](py::object self) { return xyz_view(self.cast<const Track&>().positions(), self); })
+    .def_property_readonly("momenta", [](py::object self) { return xyz_view(self.cast<const Track&>().momenta(), self); })
+    .def_property_readonly("energies", [](py::object self) {
+				       const Vec<double>& e = self.cast<const Track&>().energies();
+				       return py::array_t<double>({e.size()}, {sizeof(double)}, e.data(), self);
+				     })
+    .def("summary", &Track::summary);
+
+  py::class_<SimParticle>(m, "SimParticle")
+    .def(py::init<Particle, unsigned, double, ApproachReference>(),
+	 py::arg("particle"), py::arg("nsteps"), py::arg("step_size"), py::arg("reference") = ApproachReference())
+    .def("track", &SimParticle::track, py::arg("magnets"), py::arg("mode"), py::arg("scale") = 1., py::arg("zcutoff") = 5000.f,
+	 py::call_guard<py::gil_scoped_release>())
+    .def("summarize", &SimParticle::summarize, py::arg("magnets"), py::arg("mode"), py::arg("scale") = 1., py::arg("zcutoff") = 5000.f,
+	 py::call_guard<py::gil_scoped_release>())
+    .def_property_readonly("particle", &SimParticle::particle)
+    .def_property_readonly("nsteps", &SimParticle::nsteps)
+    .def_property_readonly("step_size", &SimParticle::step_size);
+
+  //seed None: nondeterministic
+  using Seed = std::optional<std::uint32_t>;
+  py::class_<NormalDistribution<double>> normal(m, "NormalDistribution");
+  normal.def(py::init<double, double, Seed>(), py::arg("mean"), py::arg("sigma"), py::arg("seed") = Seed());
+  bind_generator<NormalDistribution<double>, double>(normal);
+  py::class_<UniformDistribution<double>> uniform(m, "UniformDistribution");
+  uniform.def(py::init<double, double, Seed>(), py::arg("left"), py::arg("right"), py::arg("seed") = Seed());
+  bind_generator<UniformDistribution<double>, double>(uniform);
+  py::class_<BoltzmannDistribution<float>> boltzmann(m, "BoltzmannDistribution");
+  boltzmann.def(py::init<float, float, float, float, Seed>(),
+		py::arg("B") = 1.f, py::arg("temp") = 0.15f, py::arg("n") = 4.f, py::arg("m0") = 0.138f, py::arg("seed") = Seed());
+  bind_generator<BoltzmannDistribution<float>, float>(boltzmann);
+  py::class_<FermiDistribution<float>> fermi(m, "FermiDistribution");
+  fermi.def(py::init<Seed>(), py::arg("seed") = Seed());
+  bind_generator<FermiDistribution<float>, float>(fermi);
+
+  m.def("run", &run_py, "one configuration of v1_beam.exe, with its options as keyword arguments");
+}
@@ -0,0 +1,35 @@
+import numpy as np
+
+MAGIC = b'DFEVENTS'
+NAME_SIZE, TYPE_SIZE = 32, 8
+
+class Events(dict):
+    """Columns of an event file, accessible as items or attributes."""
+    def __getattr__(self, name):
+        try:
+            return self[name]
+        except KeyError:
+            raise AttributeError(name)
+
+def read(path):
+    """
+    Opens an event file written by 'v1_beam.exe --output bin'.
+    Every column is a read-only np.memmap: no parsing, no copy.
+    """
+    header = np.dtype([('magic', 'S8'), ('version', '<u4'),
+                       ('ncols', '<u4'), ('nrows', '<u8')])
+    h = np.fromfile(path, dtype=header, count=1)[0]
+    if h['magic'] != MAGIC:
+        raise RuntimeError('{} is not an event file.'.format(path))
+
+    desc = np.dtype([('name', 'S{}'.format(NAME_SIZE)),
+                     ('dtype', 'S{}'.format(TYPE_SIZE)),
+                     ('offset', '<u8')])
+    cols = np.fromfile(path, dtype=desc, count=h['ncols'], offset=header.itemsize)
+
+    ev = Events()
+    for c in cols:
+        name = c['name'].decode()
+        ev[name] = np.memmap(path, dtype=np.dtype(c['dtype'].decode()), mode='r',
+                             offset=int(c['offset']), shape=(int(h['nrows']),))
+    return ev
@@ -0,0 +1,42 @@
+import numpy as np
+import pandas as pd
+
+def read(path, flow=False):
+    """
+    Reads the histograms written by 'v1_beam.exe --histos' (data/hists_*.csv).
+    Returns a dictionary mapping each name to the np.histogram-like tuple
+    (counts, edges) for 1D histograms and (counts, xedges, yedges) for 2D ones,
+    so that the result can be passed directly as 'data' to the plotting calls.
+    Under- and overflow bins are dropped unless 'flow' is True.
+    """
+    df = pd.read_csv(path)
+    res = {}
+    for name, h in df.groupby('Name', sort=False):
+        nx = h.BinX.max() + 1
+        ny = h.BinY.max() + 1
+        if ny == 1:
+            h = h.sort_values('BinX')
+            counts = h.Content.to_numpy()
+            low = h.XLow.to_numpy()
+            res[name] = (counts, np.append(low, np.inf)) if flow else (counts[1:-1], low[1:])
+        else:
+            h = h.sort_values(['BinX', 'BinY'])
+            counts = h.Content.to_numpy().reshape(nx, ny)
+            xlow = h.XLow.to_numpy()[::ny]
+            ylow = h.YLow.to_numpy()[:ny]
+            if flow:
+                res[name] = (counts, np.append(xlow, np.inf), np.append(ylow, np.inf))
+            else:
+                res[name] = (counts[1:-1,1:-1], xlow[1:], ylow[1:])
+    return res
+
+def merge(*hists):
+    """Sums histograms read from several shards (identical binnings)."""
+    res = {}
+    for h in hists:
+        for name, t in h.items():
+            if name in res:
+                res[name] = (res[name][0] + t[0],) + res[name][1:]
+            else:
+                res[name] = t
+    return res
@@ -5,6 +5,7 @@ import numpy as np
 import bokehplot as bkp
 import argparser
 import argparse
+import eventfile
 
 from latex import LatexLabel
 from bokeh.layouts import gridplot
@@ -34,7 +35,8 @@ def run(FLAGS):
         str(FLAGS.y).replace('.', 'p') + "*" + \
         str(FLAGS.energy).replace('.', 'p') + "*" + \
         str(FLAGS.step_size).replace('.', 'p')
-    search_str = os.path.join(BASE, 'data/histo_' + FLAGS.mode + '_' + posstr + '*.csv')
+    ext = 'bin' if FLAGS.binary else 'csv'
+    search_str = os.path.join(BASE, 'data/histo_' + FLAGS.mode + '_' + posstr + '*.' + ext)
 
     l = glob.glob(search_str)
     if len(l) != 1:
@@ -44,7 +46,7 @@ def run(FLAGS):
     else:
         print('Data: ', l[0])
     
-    df = pd.read_csv( l[0] )
+    df = eventfile.read( l[0] ) if FLAGS.binary else pd.read_csv( l[0] )
     # df['sumMomXAbs'] = np.abs(df.sumMomX)
     # df['sumMomYAbs'] = np.abs(df.sumMomY)
     df['sumMomXAbs'] = df.sumMomX
@@ -5,6 +5,7 @@ import numpy as np
 import bokehplot as bkp
 import argparser
 import argparse
+import eventfile
 import re
 
 from latex import LatexLabel
@@ -35,7 +36,8 @@ def run(FLAGS):
         str(FLAGS.energy).replace('.', 'p') + "*En*" + \
         str(FLAGS.step_size).replace('.', 'p') + "*SZ*" + \
         str(FLAGS.npartons)+"NP"
-    search_str = os.path.join(BASE, 'data/histo_' + FLAGS.mode + '_' + posstr + '*.csv')
+    ext = 'bin' if FLAGS.binary else 'csv'
+    search_str = os.path.join(BASE, 'data/histo_' + FLAGS.mode + '_' + posstr + '*.' + ext)
 
     l = glob.glob(search_str)
     NFIGS = 2 * len(l) #phi and eta distributions
@@ -43,7 +45,7 @@ def run(FLAGS):
     print('Number of files: ', NFIGS)
     running_var = []
     for f in l:
-        running_var.append( float(re.findall(r'.+_(.*)EnScale.+.csv', f)[0].replace('p', '.')) )
+        running_var.append( float(re.findall(r'.+_(.*)EnScale.+.' + ext, f)[0].replace('p', '.')) )
 
     l = [ x for _,x in sorted(zip(running_var,l), key=lambda pair: pair[0]) ] #overwrite
     running_var = sorted(running_var)
@@ -91,7 +93,7 @@ def run(FLAGS):
             ) )
 
     for idx,f in enumerate(l):
-        df = pd.read_csv( f )
+        df = eventfile.read( f ) if FLAGS.binary else pd.read_csv( f )
 
         add_latex(idx)
         
@@ -0,0 +1,130 @@
+#include "include/acceptance.h"
+
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+#include <stdexcept>
+
+AcceptanceMap::AcceptanceMap(const Axes& pAxes, int pSide, const Tracking& pTracking,
+			     const std::vector<std::string>& pCalos)
+  : mAxes(pAxes), mSide(pSide), mTracking(pTracking), mCalos(pCalos),
+    mAllCalos(static_cast<uint8_t>((1u << pCalos.size()) - 1)) {
+  for(const Axis& a : mAxes)
+    if(a.nbins == 0 or !(a.hi > a.lo))
+      throw std::invalid_argument("The axes of the acceptance map need bins and a positive range.");
+  if(mSide != 1 and mSide != -1)
+    throw std::invalid_argument("The side of the acceptance map must be +1 or -1.");
+  if(mCalos.size() > mMaxCalos)
+    throw std::invalid_argument("The acceptance map supports at most 8 calorimeters.");
+  std::size_t ncells = 1;
+  for(const Axis& a : mAxes)
+    ncells *= a.nbins;
+  mCells.assign(ncells, 0);
+}
+
+void AcceptanceMap::mark(const State& s, unsigned ic) {
+  if(ic >= mCalos.size())
+    throw std::out_of_range("Unknown calorimeter in the acceptance map.");
+  std::array<int, mNaxes> bins;
+  for(unsigned a=0; a<mNaxes; ++a)
+    if((bins[a] = mAxes[a].bin(s[a])) < 0)
+      return;
+  mCells[index_(bins)] |= static_cast<uint8_t>(1u << ic);
+}
+
+void AcceptanceMap::dilate(unsigned ncells) {
+  //one pass per axis: OR of the masks within 'ncells' along that axis
+  std::array<std::size_t, mNaxes> strides;
+  strides[mNaxes-1] = 1;
+  for(unsigned a=mNaxes-1; a>0; --a)
+    strides[a-1] = strides[a] * mAxes[a].nbins;
+  for(unsigned a=0; a<mNaxes; ++a) {
+    const std::vector<uint8_t> src = mCells;
+    for(std::size_t i=0; i<mCells.size(); ++i) {
+      const int pos = static_cast<int>(i / strides[a] % mAxes[a].nbins);
+      const int beg = std::max(0, pos - static_cast<int>(ncells));
+      const int end = std::min(static_cast<int>(mAxes[a].nbins) - 1, pos + static_cast<int>(ncells));
+      uint8_t m = 0;
+      for(int k=beg; k<=end; ++k)
+	m |= src[i + (k - pos) * static_cast<std::ptrdiff_t>(strides[a])];
+      mCells[i] = m;
+    }
+  }
+}
+
+double AcceptanceMap::occupancy() const {
+  const auto n = std::count_if(mCells.begin(), mCells.end(), [](uint8_t c) { return c != 0; });
+  return static_cast<double>(n) / mCells.size();
+}
+
+void AcceptanceMap::write(const std::string& filename) const {
+  std::ofstream f(filename, std::ios_base::out | std::ios_base::binary);
+  if(!f.is_open())
+    throw std::runtime_error("Failed to open " + filename);
+
+  const int32_t side = mSide;
+  const uint32_t ncalos = mCalos.size();
+  f.write(mMagic, 8);
+  f.write(reinterpret_cast<const char*>(&mVersion), sizeof(mVersion));
+  f.write(reinterpret_cast<const char*>(&side), sizeof(side));
+  f.write(reinterpret_cast<const char*>(&mTracking.mode), sizeof(mTracking.mode));
+  f.write(reinterpret_cast<const char*>(&mTracking.zcutoff), sizeof(mTracking.zcutoff));
+  f.write(reinterpret_cast<const char*>(&mTracking.Bscale), sizeof(mTracking.Bscale));
+  for(const Axis& a : mAxes) {
+    f.write(reinterpret_cast<const char*>(&a.nbins), sizeof(a.nbins));
+    f.write(reinterpret_cast<const char*>(&a.lo), sizeof(a.lo));
+    f.write(reinterpret_cast<const char*>(&a.hi), sizeof(a.hi));
+  }
+  f.write(reinterpret_cast<const char*>(&ncalos), sizeof(ncalos));
+  for(const std::string& name : mCalos) {
+    if(name.size() >= mNameSize)
+      throw std::invalid_argument("Calorimeter name too long: " + name);
+    char n[mNameSize] = {};
+    std::strncpy(n, name.c_str(), mNameSize-1);
+    f.write(n, mNameSize);
+  }
+  f.write(reinterpret_cast<const char*>(mCells.data()), mCells.size());
+
+  if(!f)
+    throw std::runtime_error("Failed to write " + filename);
+}
+
+AcceptanceMap AcceptanceMap::read(const std::string& filename) {
+  std::ifstream f(filename, std::ios_base::in | std::ios_base::binary);
+  if(!f.is_open())
+    throw std::runtime_error("Failed to open " + filename);
+
+  char magic[8];
+  uint32_t version, ncalos;
+  int32_t side;
+  f.read(magic, 8);
+  f.read(reinterpret_cast<char*>(&version), sizeof(version));
+  if(!f or std::memcmp(magic, mMagic, 8) != 0 or version != mVersion)
+    throw std::runtime_error(filename + " is not an acceptance map (version " + std::to_string(mVersion) + ").");
+  f.read(reinterpret_cast<char*>(&side), sizeof(side));
+  Tracking tracking;
+  f.read(reinterpret_cast<char*>(&tracking.mode), sizeof(tracking.mode));
+  f.read(reinterpret_cast<char*>(&tracking.zcutoff), sizeof(tracking.zcutoff));
+  f.read(reinterpret_cast<char*>(&tracking.Bscale), sizeof(tracking.Bscale));
+  Axes axes;
+  for(Axis& a : axes) {
+    f.read(reinterpret_cast<char*>(&a.nbins), sizeof(a.nbins));
+    f.read(reinterpret_cast<char*>(&a.lo), sizeof(a.lo));
+    f.read(reinterpret_cast<char*>(&a.hi), sizeof(a.hi));
+  }
+  f.read(reinterpret_cast<char*>(&ncalos), sizeof(ncalos));
+  if(!f or ncalos > mMaxCalos)
+    throw std::runtime_error("Corrupted acceptance map header in " + filename);
+  std::vector<std::string> calos;
+  for(uint32_t i=0; i<ncalos; ++i) {
+    char n[mNameSize];
+    f.read(n, mNameSize);
+    calos.emplace_back(n, std::find(n, n + mNameSize, '\0'));
+  }
+
+  AcceptanceMap map(axes, side, tracking, calos);
+  f.read(reinterpret_cast<char*>(map.mCells.data()), map.mCells.size());
+  if(!f)
+    throw std::runtime_error("Failed to read " + filename);
+  return map;
+}
@@ -0,0 +1,109 @@
+#include "include/display.h"
+
+#include <algorithm>
+#include <limits>
+
+#include "TStyle.h"
+
+void MagnetSystem::draw() const {
+
+  std::vector<TEveBox*> magnets( mMagnets.size() );
+
+    
+  for(unsigned im=0; im<mMagnets.size(); im++)
+    {
+      magnets[im] = new TEveBox;
+      magnets[im]->SetName( mMagnets[im].label.c_str() );
+
+      Dimensions d = mMagnets[im].dims;
+      magnets[im]->SetVertex(0, d.X().first,  d.Y().first,  d.Z().first);
+      magnets[im]->SetVertex(1, d.X().second, d.Y().first,  d.Z().first);
+      magnets[im]->SetVertex(2, d.X().second, d.Y().second, d.Z().first);
+      magnets[im]->SetVertex(3, d.X().first,  d.Y().second, d.Z().first);
+      magnets[im]->SetVertex(4, d.X().first,  d.Y().first,  d.Z().second);
+      magnets[im]->SetVertex(5, d.X().second, d.Y().first,  d.Z().second);
+      magnets[im]->SetVertex(6, d.X().second, d.Y().second, d.Z().second);
+      magnets[im]->SetVertex(7, d.X().first,  d.Y().second, d.Z().second);
+
+      magnets[im]->SetMainColor(mMagnets[im].color);
+      magnets[im]->SetMainTransparency(75); // the higher the value the more transparent
+	
+      gEve->AddElement(magnets[im]);
+    }
+
+}
+
+void CaloSystem::draw() const {
+
+  std::vector<TEveBox*> calos( mCalos.size() );
+
+    
+  for(unsigned im=0; im<mCalos.size(); im++)
+    {
+      calos[im] = new TEveBox;
+      calos[im]->SetName( mCalos[im].label.c_str() );
+
+      Dimensions d = mCalos[im].dims;
+      calos[im]->SetVertex(0, d.X().first,  d.Y().first,  d.Z().first);
+      calos[im]->SetVertex(1, d.X().second, d.Y().first,  d.Z().first);
+      calos[im]->SetVertex(2, d.X().second, d.Y().second, d.Z().first);
+      calos[im]->SetVertex(3, d.X().first,  d.Y().second, d.Z().first);
+      calos[im]->SetVertex(4, d.X().first,  d.Y().first,  d.Z().second);
+      calos[im]->SetVertex(5, d.X().second, d.Y().first,  d.Z().second);
+      calos[im]->SetVertex(6, d.X().second, d.Y().second, d.Z().second);
+      calos[im]->SetVertex(7, d.X().first,  d.Y().second, d.Z().second);
+
+      calos[im]->SetMainColor(mCalos[im].color);
+      calos[im]->SetMainTransparency(75); // the higher the value the more transparent
+	
+      gEve->AddElement(calos[im]);
+    }
+
+}
+
+void EveDisplay::geometry(const MagnetSystem& magnets, const CaloSystem& calos, float zcutoff) {
+  gStyle->SetPalette(56); // 53 = black body radiation, 56 = inverted black body radiator, 103 = sunset, 87 == light temperature
+  float beamcap = zcutoff+100;
+  BuildGeom(Dimensions{0., 0., 0., 0., -beamcap, beamcap}, //beamline coordinates
+	    magnets, calos);
+}
+
+void EveDisplay::tracks(const Vec<Track>& tracks1, const Vec<Track>& tracks2, const Vec<unsigned char>& drawn) {
+  unsigned minelem = std::numeric_limits<unsigned>::max();
+  for(unsigned ix=0; ix<tracks1.size(); ix++)
+    if(drawn[ix])
+      minelem = std::min(minelem, tracks1[ix].steps_used());
+
+  for(unsigned ix=0; ix<tracks1.size(); ix++) {
+    if(!drawn[ix])
+      continue;
+    TEveLine* particleTrackViz1 = new TEveLine();
+    TEveLine* particleTrackViz2 = new TEveLine();
+    const Vec<XYZ>& pos1 = tracks1[ix].positions();
+    const Vec<XYZ>& pos2 = tracks2[ix].positions();
+    for(unsigned i_step = 0; i_step<minelem; i_step++) {
+      particleTrackViz1->SetNextPoint(pos1[i_step].X(), pos1[i_step].Y(), pos1[i_step].Z());
+      particleTrackViz2->SetNextPoint(pos2[i_step].X(), pos2[i_step].Y(), pos2[i_step].Z());
+    }
+
+    const std::string histname1 = "track_zpos_ " + std::to_string(ix);
+    particleTrackViz1->SetName( histname1.c_str() );
+    particleTrackViz1->SetLineStyle(1);
+    particleTrackViz1->SetLineWidth(2);
+    particleTrackViz1->SetMainAlpha(0.7);
+    particleTrackViz1->SetMainColor(kRed+3);
+
+    const std::string histname2 = "track_zneg_ " + std::to_string(ix);
+    particleTrackViz2->SetName( histname2.c_str() );
+    particleTrackViz2->SetLineStyle(1);
+    particleTrackViz2->SetLineWidth(2);
+    particleTrackViz2->SetMainAlpha(0.7);
+    particleTrackViz2->SetMainColor(kRed-7);
+    gEve->AddElement(particleTrackViz1);
+    gEve->AddElement(particleTrackViz2);
+  }
+}
+
+void EveDisplay::show() {
+  gEve->Redraw3D(kTRUE);
+}
@@ -0,0 +1,181 @@
+#include "include/eventfile.h"
+
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <stdexcept>
+
+void HistoColumns::append(const HistoRecord& r) {
+  iBatch.push_back(r.iBatch);
+  idx.push_back(r.idx);
+  sumMomX.push_back(r.sumMomX);
+  sumMomY.push_back(r.sumMomY);
+  sumMomZ.push_back(r.sumMomZ);
+  fermiPzBeforeBoost.push_back(r.fermiPzBeforeBoost);
+  fermiPzAfterBoost.push_back(r.fermiPzAfterBoost);
+  xHitNoBoost.push_back(r.xHitNoBoost);
+  yHitNoBoost.push_back(r.yHitNoBoost);
+  xHit.push_back(r.xHit);
+  yHit.push_back(r.yHit);
+  psiA.push_back(r.psiA);
+  psiB.push_back(r.psiB);
+  cat1.push_back(r.cat1);
+  psi.push_back(r.psi);
+  phi.push_back(r.phi);
+  eta.push_back(r.eta);
+  cos.push_back(r.cos);
+}
+
+void HistoColumns::clear() {
+  iBatch.clear();
+  idx.clear();
+  sumMomX.clear();
+  sumMomY.clear();
+  sumMomZ.clear();
+  fermiPzBeforeBoost.clear();
+  fermiPzAfterBoost.clear();
+  xHitNoBoost.clear();
+  yHitNoBoost.clear();
+  xHit.clear();
+  yHit.clear();
+  psiA.clear();
+  psiB.clear();
+  cat1.clear();
+  psi.clear();
+  phi.clear();
+  eta.clear();
+  cos.clear();
+}
+
+namespace {
+  uint64_t align(uint64_t n, uint64_t a) {
+    return (n + a - 1) / a * a;
+  }
+
+  void pad(std::ostream& f, uint64_t from, uint64_t to) {
+    static const char zeros[EventFile::mAlignment] = {};
+    f.write(zeros, to - from);
+  }
+}
+
+std::vector<uint64_t> EventFile::write_header(std::ostream& f, uint64_t nrows) {
+  const uint32_t ncols = HistoRecord::columns().size();
+
+  f.write(mMagic, 8);
+  f.write(reinterpret_cast<const char*>(&mVersion), sizeof(mVersion));
+  f.write(reinterpret_cast<const char*>(&ncols), sizeof(ncols));
+  f.write(reinterpret_cast<const char*>(&nrows), sizeof(nrows));
+
+  //column descriptors
+  const uint64_t headerSize = 8 + 4 + 4 + 8 + ncols * (mNameSize + mTypeSize + 8);
+  uint64_t offset = align(headerSize, mAlignment);
+  std::vector<uint64_t> offsets;
+  HistoColumns().for_each_column([&](const std::string& name, const char* dtype, const void*, std::size_t size) {
+				   if(name.size() >= mNameSize)
+				     throw std::invalid_argument("Column name too long: " + name);
+				   char n[mNameSize] = {};
+				   char t[mTypeSize] = {};
+				   std::strncpy(n, name.c_str(), mNameSize-1);
+				   std::strncpy(t, dtype, mTypeSize-1);
+				   f.write(n, mNameSize);
+				   f.write(t, mTypeSize);
+				   f.write(reinterpret_cast<const char*>(&offset), sizeof(offset));
+				   offsets.push_back(offset);
+				   offset = align(offset + nrows*size, mAlignment);
+				 });
+  //padding up to the first column block
+  pad(f, headerSize, offsets.front());
+  return offsets;
+}
+
+void EventFile::write(const std::string& filename, const HistoColumns& cols) {
+  std::ofstream f(filename, std::ios_base::out | std::ios_base::binary);
+  if(!f.is_open())
+    throw std::runtime_error("Failed to open " + filename);
+
+  const uint64_t nrows = cols.size();
+  const std::vector<uint64_t> offsets = write_header(f, nrows);
+
+  //column blocks
+  unsigned ic = 0;
+  cols.for_each_column([&](const std::string&, const char*, const void* data, std::size_t size) {
+			 uint64_t pos = f.tellp();
+			 pad(f, pos, offsets[ic++]);
+			 f.write(static_cast<const char*>(data), nrows*size);
+		       });
+
+  if(!f)
+    throw std::runtime_error("Failed to write " + filename);
+}
+
+EventFileWriter::EventFileWriter(const std::string& filename)
+  : mFilename(filename), mPartName(filename + ".part") {
+  mPart.open(mPartName, std::ios_base::in | std::ios_base::out | std::ios_base::trunc | std::ios_base::binary);
+  if(!mPart.is_open())
+    throw std::runtime_error("Failed to open " + mPartName);
+}
+
+EventFileWriter::~EventFileWriter() {
+  try { close(); }
+  catch(const std::exception& e) { std::cerr << e.what() << std::endl; }
+}
+
+void EventFileWriter::flush() {
+  if(!mPart.is_open())
+    throw std::runtime_error("EventFileWriter: " + mFilename + " is closed.");
+  const uint64_t n = mBatch.size();
+  if(n == 0)
+    return;
+  mBatch.for_each_column([&](const std::string&, const char*, const void* data, std::size_t size) {
+			   mPart.write(static_cast<const char*>(data), n*size);
+			 });
+  if(!mPart)
+    throw std::runtime_error("Failed to write " + mPartName);
+  mSegmentRows.push_back(n);
+  mNrows += n;
+  mBatch.clear();
+}
+
+void EventFileWriter::close() {
+  if(!mPart.is_open())
+    return;
+  flush();
+
+  std::ofstream f(mFilename, std::ios_base::out | std::ios_base::binary);
+  if(!f.is_open())
+    throw std::runtime_error("Failed to open " + mFilename);
+  const std::vector<uint64_t> offsets = EventFile::write_header(f, mNrows);
+
+  /*
+    Segment k holds the slices of all columns for its rows, one after the other;
+    column c of segment k starts at the segment start plus the sizes of the
+    slices of the previous columns.
+  */
+  std::vector<std::size_t> sizes;
+  mBatch.for_each_column([&](const std::string&, const char*, const void*, std::size_t size) {
+			   sizes.push_back(size);
+			 });
+  std::vector<char> buffer;
+  for(unsigned ic=0; ic<sizes.size(); ++ic) {
+    uint64_t pos = f.tellp();
+    pad(f, pos, offsets[ic]);
+    uint64_t segmentStart = 0;
+    for(uint64_t rows : mSegmentRows) {
+      uint64_t sliceStart = segmentStart;
+      for(unsigned jc=0; jc<ic; ++jc)
+	sliceStart += rows*sizes[jc];
+      buffer.resize(rows*sizes[ic]);
+      mPart.seekg(sliceStart);
+      mPart.read(buffer.data(), buffer.size());
+      f.write(buffer.data(), buffer.size());
+      for(std::size_t size : sizes)
+	segmentStart += rows*size;
+    }
+  }
+  const bool failed = !mPart or !f;
+  mPart.close();
+  std::remove(mPartName.c_str());
+  if(failed)
+    throw std::runtime_error("Failed to write " + mFilename);
+}
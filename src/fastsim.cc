@@ -0,0 +1,191 @@
+#include "include/fastsim.h"
+
+#include <cmath>
+#include <stdexcept>
+
+TrackTable::TrackTable(const Particle& pTemplate, const std::array<Axis,NVARS>& pAxes,
+		       const MagnetSystem& pMagnets, tracking::TrackMode pMode,
+		       unsigned pNsteps, double pStepSize, double pScale, float pZcutoff,
+		       ApproachReference pReference)
+  : mTemplate(pTemplate), mAxes(pAxes), mMagnets(pMagnets), mMode(pMode),
+    mNsteps(pNsteps), mStepSize(pStepSize), mScale(pScale), mZcutoff(pZcutoff),
+    mReference(pReference) {
+  std::size_t n = 1;
+  for(int v=NVARS-1; v>=0; --v) { //P runs fastest
+    if(mAxes[v].n == 0 or mAxes[v].hi < mAxes[v].lo)
+      throw std::invalid_argument("Every axis of the track table needs a node and an ordered range.");
+    mStrides[v] = n;
+    n *= mAxes[v].n;
+  }
+  if(mTemplate.mom.Z() == 0.)
+    throw std::invalid_argument("The template particle must move along z.");
+
+  mNodes.resize(n);
+  for(std::size_t i=0; i<n; ++i) {
+    std::array<double,NVARS> s;
+    for(unsigned v=0; v<NVARS; ++v)
+      s[v] = mAxes[v].node(i / mStrides[v] % mAxes[v].n);
+    mNodes[i] = track_(particle_(s));
+  }
+}
+
+Particle TrackTable::particle_(const std::array<double,NVARS>& s) const {
+  Particle p = mTemplate;
+  const double pt2 = s[PX]*s[PX] + s[PY]*s[PY];
+  if(pt2 >= s[P]*s[P])
+    throw std::invalid_argument("The transverse momentum of the track table exceeds the momentum.");
+  const double pz = std::copysign(std::sqrt(s[P]*s[P] - pt2), mTemplate.mom.Z());
+  p.pos = XYZ(s[X], s[Y], mTemplate.pos.Z());
+  p.mom = XYZ(s[PX], s[PY], pz);
+  return p;
+}
+
+std::array<double,TrackTable::NVARS> TrackTable::state_(const Particle& p) const {
+  return {{ p.pos.X(), p.pos.Y(), p.mom.X(), p.mom.Y(), std::sqrt(p.mom.Mag2()) }};
+}
+
+TrackSummary TrackTable::track_(const Particle& p) const {
+  return SimParticle(p, mNsteps, mStepSize, mReference).summarize(mMagnets, mMode, mScale, mZcutoff);
+}
+
+bool TrackTable::contains(const Particle& p) const {
+  if(p.pos.Z() != mTemplate.pos.Z() or (p.mom.Z() < 0) != (mTemplate.mom.Z() < 0))
+    return false;
+  const auto s = state_(p);
+  for(unsigned v=0; v<NVARS; ++v) {
+    const double tol = 1e-12 * std::max(1., std::abs(mAxes[v].lo)); //single nodes
+    if(s[v] < mAxes[v].lo - tol or s[v] > mAxes[v].hi + tol)
+      return false;
+  }
+  return true;
+}
+
+TrackSummary TrackTable::summarize(const Particle& p) const {
+  if(!contains(p))
+    return track_(p);
+
+  //lower node and weight of the upper node along each interpolated axis
+  const auto s = state_(p);
+  std::array<std::size_t,NVARS> lower;
+  std::array<double,NVARS> frac;
+  std::array<unsigned,NVARS> active;
+  unsigned nactive = 0;
+  std::size_t base = 0;
+  for(unsigned v=0; v<NVARS; ++v) {
+    lower[v] = 0;
+    frac[v] = 0.;
+    if(mAxes[v].n > 1) {
+      const double u = (s[v] - mAxes[v].lo) / (mAxes[v].hi - mAxes[v].lo) * (mAxes[v].n - 1);
+      lower[v] = std::min(static_cast<std::size_t>(std::max(u, 0.)), static_cast<std::size_t>(mAxes[v].n - 2));
+      frac[v] = u - lower[v];
+      active[nactive++] = v;
+    }
+    base += lower[v] * mStrides[v];
+  }
+
+  TrackSummary res;
+  double nsteps = 0.;
+  for(unsigned corner=0; corner < (1u << nactive); ++corner) {
+    double w = 1.;
+    std::size_t idx = base;
+    for(unsigned a=0; a<nactive; ++a) {
+      const unsigned v = active[a];
+      const bool upper = corner & (1u << a);
+      w *= upper ? frac[v] : 1. - frac[v];
+      idx += upper ? mStrides[v] : 0;
+    }
+    const TrackSummary& node = mNodes[idx];
+    nsteps += w * node.nStepsUsed;
+    res.lastPos += w * node.lastPos;
+    res.lastMom += w * node.lastMom;
+    res.closest.step += w * node.closest.step;
+    res.closest.pos += w * node.closest.pos;
+    res.closest.mom += w * node.closest.mom;
+  }
+  res.nStepsUsed = static_cast<unsigned>(std::lround(nsteps));
+  //the distance has a kink where the closest approach crosses the reference: it is
+  //recomputed from the interpolated position instead of being interpolated itself
+  res.closest.distance = std::sqrt(mReference.separation(res.closest.pos).Mag2());
+  return res;
+}
+
+TrackTable::ErrorReport TrackTable::validate(unsigned nsamples, std::mt19937& rng) const {
+  ErrorReport rep;
+  std::uniform_real_distribution<double> unif(0., 1.);
+  for(unsigned i=0; i<nsamples; ++i) {
+    std::array<double,NVARS> s;
+    for(unsigned v=0; v<NVARS; ++v)
+      s[v] = mAxes[v].lo + unif(rng) * (mAxes[v].hi - mAxes[v].lo);
+    const Particle p = particle_(s);
+    const TrackSummary approx = summarize(p);
+    const TrackSummary exact = track_(p);
+
+    const std::array<double,4> diffs = {{ std::sqrt((approx.lastPos - exact.lastPos).Mag2()),
+					  std::sqrt((approx.lastMom - exact.lastMom).Mag2()),
+					  std::sqrt((approx.closest.pos - exact.closest.pos).Mag2()),
+					  std::sqrt((approx.closest.mom - exact.closest.mom).Mag2()) }};
+    for(unsigned k=0; k<diffs.size(); ++k) {
+      rep.max[k] = std::max(rep.max[k], diffs[k]);
+      rep.rms[k] += diffs[k]*diffs[k];
+    }
+  }
+  rep.nsamples = nsamples;
+  for(double& r : rep.rms)
+    r = nsamples>0 ? std::sqrt(r/nsamples) : 0.;
+  return rep;
+}
+
+std::shared_ptr<const TrackTable> TrackTableCache::get(const Particle& tmpl, const Axes& axes,
+						       tracking::TrackMode mode, unsigned nsteps, double stepsize,
+						       double scale, float zcutoff, ApproachReference reference) {
+  //the nodes only take the starting z, the direction along z and the particle from the template
+  Key key = { tmpl.pos.Z(), std::copysign(1., tmpl.mom.Z()), tmpl.energy, tmpl.mass, static_cast<double>(tmpl.charge),
+	      static_cast<double>(mode), static_cast<double>(nsteps), stepsize, scale, zcutoff,
+	      reference.origin().X(), reference.origin().Y(), reference.origin().Z(),
+	      reference.direction().X(), reference.direction().Y(), reference.direction().Z() };
+  for(const TrackTable::Axis& a : axes)
+    key.insert(key.end(), { static_cast<double>(a.n), a.lo, a.hi });
+
+  std::promise<std::shared_ptr<const TrackTable>> promise;
+  {
+    std::unique_lock<std::mutex> lock(mMutex);
+    auto it = mTables.find(key);
+    if(it != mTables.end()) {
+      ++mHits;
+      mLru.splice(mLru.begin(), mLru, it->second.lru);
+      Table table = it->second.table;
+      lock.unlock();
+      return table.get(); //waits while another run builds it
+    }
+    ++mMisses;
+    mLru.push_front(key);
+    mTables.emplace(key, Entry{promise.get_future().share(), mLru.begin()});
+    while(mTables.size() > mCapacity) {
+      mTables.erase(mLru.back());
+      mLru.pop_back();
+    }
+  }
+
+  try {
+    auto table = std::make_shared<const TrackTable>(tmpl, axes, mMagnets, mode, nsteps, stepsize,
+						    scale, zcutoff, reference);
+    promise.set_value(table);
+    return table;
+  }
+  catch(...) {
+    //the runs waiting for it get the error; the next one tries again
+    promise.set_exception(std::current_exception());
+    std::lock_guard<std::mutex> lock(mMutex);
+    auto it = mTables.find(key);
+    if(it != mTables.end()) {
+      mLru.erase(it->second.lru);
+      mTables.erase(it);
+    }
+    throw;
+  }
+}
+
+std::size_t TrackTableCache::size() const {
+  std::lock_guard<std::mutex> lock(mMutex);
+  return mTables.size();
+}
@@ -0,0 +1,140 @@
+#include "include/kinematics.h"
+
+namespace kinematics {
+
+  void dot(const ThreeVectors& v, const XYZ& u, double* out) {
+    const double* x = v.x.data();
+    const double* y = v.y.data();
+    const double* z = v.z.data();
+    const double ux = u.X(), uy = u.Y(), uz = u.Z();
+#pragma omp simd
+    for(std::size_t i=0; i<v.size(); ++i)
+      out[i] = x[i]*ux + y[i]*uy + z[i]*uz;
+  }
+
+  void direction_dot(const ThreeVectors& v, const XYZ& u, double scale, double* out) {
+    const double* x = v.x.data();
+    const double* y = v.y.data();
+    const double* z = v.z.data();
+    const double ux = u.X(), uy = u.Y(), uz = u.Z();
+#pragma omp simd
+    for(std::size_t i=0; i<v.size(); ++i) {
+      const double mag = std::sqrt(x[i]*x[i] + y[i]*y[i] + z[i]*z[i]);
+      const double f = (mag > 0. ? scale : 0.) / (mag > 0. ? mag : 1.);
+      out[i] = f * (x[i]*ux + y[i]*uy + z[i]*uz);
+    }
+  }
+
+  void atan2(const double* y, const double* x, std::size_t n, double* out) {
+#pragma omp simd
+    for(std::size_t i=0; i<n; ++i)
+      out[i] = fast_atan2(y[i], x[i]);
+  }
+
+  void phi(const ThreeVectors& v, double* out) {
+    const double* x = v.x.data();
+    const double* y = v.y.data();
+#pragma omp simd
+    for(std::size_t i=0; i<v.size(); ++i)
+      out[i] = fast_atan2(y[i], x[i]); //already 0 for x = y = 0
+  }
+
+  void eta(const ThreeVectors& v, double* out) {
+    const double* x = v.x.data();
+    const double* y = v.y.data();
+    const double* z = v.z.data();
+#pragma omp simd
+    for(std::size_t i=0; i<v.size(); ++i) {
+      //-ln(tan(theta/2)) = sign(z) * ln((|p| + |z|) / pt), without cancellations at large |eta|
+      const double pt = std::sqrt(x[i]*x[i] + y[i]*y[i]);
+      const double az = std::abs(z[i]);
+      const double p = std::sqrt(pt*pt + az*az);
+      const double r = fast_log((p + az) / (pt > 0. ? pt : 1.));
+      const double l = pt > 0. ? r : (az > 0. ? 1e11 : 0.);
+      out[i] = z[i] < 0. ? -l : l;
+    }
+  }
+
+  void set_mass(FourVectors& v, double mass) {
+    const double* x = v.p.x.data();
+    const double* y = v.p.y.data();
+    const double* z = v.p.z.data();
+    double* e = v.e.data();
+    const double m2 = mass*mass;
+#pragma omp simd
+    for(std::size_t i=0; i<v.size(); ++i)
+      e[i] = std::sqrt(x[i]*x[i] + y[i]*y[i] + z[i]*z[i] + m2);
+  }
+
+  void add(const FourVectors& a, const FourVectors& b, FourVectors& out) {
+#pragma omp simd
+    for(std::size_t i=0; i<a.size(); ++i) {
+      out.p.x[i] = a.p.x[i] + b.p.x[i];
+      out.p.y[i] = a.p.y[i] + b.p.y[i];
+      out.p.z[i] = a.p.z[i] + b.p.z[i];
+      out.e[i] = a.e[i] + b.e[i];
+    }
+  }
+
+  void boost_vectors(const FourVectors& v, ThreeVectors& beta) {
+#pragma omp simd
+    for(std::size_t i=0; i<v.size(); ++i) {
+      beta.x[i] = v.p.x[i] / v.e[i];
+      beta.y[i] = v.p.y[i] / v.e[i];
+      beta.z[i] = v.p.z[i] / v.e[i];
+    }
+  }
+
+  void boost(FourVectors& v, const ThreeVectors& beta) {
+    double* x = v.p.x.data();
+    double* y = v.p.y.data();
+    double* z = v.p.z.data();
+    double* t = v.e.data();
+    const double* bx = beta.x.data();
+    const double* by = beta.y.data();
+    const double* bz = beta.z.data();
+#pragma omp simd
+    for(std::size_t i=0; i<v.size(); ++i) {
+      const double b2 = bx[i]*bx[i] + by[i]*by[i] + bz[i]*bz[i];
+      const double gamma = 1.0 / std::sqrt(1.0 - b2);
+      const double bp = bx[i]*x[i] + by[i]*y[i] + bz[i]*z[i];
+      const double gamma2 = (gamma - 1.0) / (b2 > 0 ? b2 : 1.0); //gamma = 1 for b2 = 0
+
+      x[i] += gamma2*bp*bx[i] + gamma*bx[i]*t[i];
+      y[i] += gamma2*bp*by[i] + gamma*by[i]*t[i];
+      z[i] += gamma2*bp*bz[i] + gamma*bz[i]*t[i];
+      t[i] = gamma*(t[i] + bp);
+    }
+  }
+
+  void intersect_box(const ThreeVectors& pos, const ThreeVectors& dir,
+		     const XYZ& lo, const XYZ& hi,
+		     ThreeVectors& hit, unsigned char* accepted) {
+    const double* px = pos.x.data();
+    const double* py = pos.y.data();
+    const double* pz = pos.z.data();
+    const double* dx = dir.x.data();
+    const double* dy = dir.y.data();
+    const double* dz = dir.z.data();
+    const double lx = lo.X(), ly = lo.Y(), lz = lo.Z();
+    const double hx = hi.X(), hy = hi.Y(), hz = hi.Z();
+    constexpr double tiny = 1e-300; //a null component makes its slab span all t (or none)
+#pragma omp simd
+    for(std::size_t i=0; i<pos.size(); ++i) {
+      const double ix = 1. / (dx[i] != 0. ? dx[i] : tiny);
+      const double iy = 1. / (dy[i] != 0. ? dy[i] : tiny);
+      const double iz = 1. / (dz[i] != 0. ? dz[i] : tiny);
+      const double ax = (lx - px[i])*ix, bx = (hx - px[i])*ix;
+      const double ay = (ly - py[i])*iy, by = (hy - py[i])*iy;
+      const double az = (lz - pz[i])*iz, bz = (hz - pz[i])*iz;
+      const double tin = std::max(std::max(std::min(ax, bx), std::min(ay, by)),
+				  std::max(std::min(az, bz), 0.));
+      const double tout = std::min(std::min(std::max(ax, bx), std::max(ay, by)), std::max(az, bz));
+      accepted[i] = tin <= tout;
+      hit.x[i] = px[i] + tin*dx[i];
+      hit.y[i] = py[i] + tin*dy[i];
+      hit.z[i] = pz[i] + tin*dz[i];
+    }
+  }
+
+}
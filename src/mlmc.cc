@@ -0,0 +1,107 @@
+#include "include/mlmc.h"
+
+double MultilevelMC::Level::variance() const {
+  if(nsamples<2)
+    return 0.;
+  double m = mean();
+  return std::max(0., sum2/nsamples - m*m);
+}
+
+void MultilevelMC::sample_level(unsigned l, unsigned n, Sampler& sampler, Observable& obs,
+				double scale, float zcutoff) {
+  Level& lvl = mLevels[l];
+  for(unsigned i=0; i<n; ++i) {
+    Particle p = sampler(mRng);
+
+    SimParticle fine(p, nsteps(l), step_size(l), mReference);
+    const TrackSummary fineTrack = fine.summarize(mMagnets, mMode, scale, zcutoff);
+    double y = obs(fineTrack);
+    lvl.cost += fineTrack.nStepsUsed;
+
+    if(l>0) {
+      SimParticle coarse(p, nsteps(l-1), step_size(l-1), mReference);
+      const TrackSummary coarseTrack = coarse.summarize(mMagnets, mMode, scale, zcutoff);
+      y -= obs(coarseTrack);
+      lvl.cost += coarseTrack.nStepsUsed;
+    }
+
+    lvl.sum += y;
+    lvl.sum2 += y*y;
+    ++lvl.nsamples;
+  }
+}
+
+void MultilevelMC::allocate_(double tolerance, Sampler& sampler, Observable& obs,
+			    double scale, float zcutoff) {
+  //optimal allocation: N_l = 2/tol^2 * sqrt(V_l/C_l) * sum_k sqrt(V_k*C_k)
+  bool converged = false;
+  while(!converged) {
+    double sumVC = 0.;
+    for(auto&& lvl : mLevels)
+      sumVC += std::sqrt(lvl.variance() * lvl.cost_per_sample());
+
+    converged = true;
+    for(unsigned l=0; l<mLevels.size(); ++l) {
+      const Level& lvl = mLevels[l];
+      if(lvl.cost_per_sample() == 0.)
+	continue;
+      double nopt = 2. / (tolerance*tolerance) * std::sqrt(lvl.variance()/lvl.cost_per_sample()) * sumVC;
+      unsigned nextra = nopt > lvl.nsamples ? static_cast<unsigned>(std::ceil(nopt)) - lvl.nsamples : 0;
+      if(nextra > 0) {
+	sample_level(l, nextra, sampler, obs, scale, zcutoff);
+	converged = false;
+      }
+    }
+  }
+}
+
+double MultilevelMC::estimate(Sampler sampler, Observable obs, double tolerance,
+			      unsigned npilot, double scale, float zcutoff) {
+  if(mMaxLevels == 0)
+    throw std::invalid_argument("At least one level is required.");
+  if(mRefinement < 2)
+    throw std::invalid_argument("The refinement ratio must be at least 2.");
+  if(tolerance <= 0.)
+    throw std::invalid_argument("The tolerance must be positive.");
+
+  mLevels.assign(std::min(mMaxLevels, 2u), Level{});
+  for(unsigned l=0; l<mLevels.size(); ++l)
+    sample_level(l, npilot, sampler, obs, scale, zcutoff);
+
+  /*
+    With a convergence order of at least one in the step size, the bias left
+    after level L is at most |E[P_L - P_{L-1}]| / (r-1) <= |E[P_L - P_{L-1}]|,
+    so levels are added until that correction is below tolerance/sqrt(2).
+  */
+  while(true) {
+    allocate_(tolerance, sampler, obs, scale, zcutoff);
+    if(mLevels.size() == mMaxLevels or bias() <= tolerance/std::sqrt(2.))
+      break;
+    mLevels.emplace_back();
+    sample_level(mLevels.size()-1, npilot, sampler, obs, scale, zcutoff);
+  }
+
+  double res = 0.;
+  for(auto&& lvl : mLevels)
+    res += lvl.mean();
+  return res;
+}
+
+double MultilevelMC::bias() const {
+  if(mLevels.size() < 2)
+    return std::nan("");
+  return std::abs(mLevels.back().mean());
+}
+
+double MultilevelMC::standard_error(unsigned l) const {
+  const Level& lvl = mLevels.at(l);
+  return lvl.nsamples>0 ? std::sqrt(lvl.variance() / lvl.nsamples) : 0.;
+}
+
+double MultilevelMC::variance() const {
+  double var = 0.;
+  for(auto&& lvl : mLevels)
+    if(lvl.nsamples>0)
+      var += lvl.variance() / lvl.nsamples;
+  return var;
+}
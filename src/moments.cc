@@ -0,0 +1,63 @@
+#include "include/moments.h"
+
+#include <algorithm>
+#include <cmath>
+#include <stdexcept>
+
+std::pair<double,double> BeamTransport::Moments::propagate(double value, const Outcomes& gradient) const {
+  return std::make_pair(value, std::sqrt(std::max(0., ROOT::Math::Similarity(cov, gradient))));
+}
+
+BeamTransport::BeamTransport(const MagnetSystem& pMagnets, tracking::TrackMode pMode,
+			     unsigned pNsteps, double pStepSize, double pScale, float pZcutoff,
+			     ApproachReference pReference)
+  : mMagnets(pMagnets), mMode(pMode), mNsteps(pNsteps), mStepSize(pStepSize),
+    mScale(pScale), mZcutoff(pZcutoff), mReference(pReference) {}
+
+BeamTransport::Outcomes BeamTransport::outcomes(const Particle& p) const {
+  const TrackSummary s = SimParticle(p, mNsteps, mStepSize, mReference).summarize(mMagnets, mMode, mScale, mZcutoff);
+  const double norm = std::sqrt(s.lastPos.Mag2());
+  if(!(norm > 0.))
+    throw std::runtime_error("The beam track ends at the origin: its direction is undefined.");
+
+  Outcomes o;
+  o[DirX] = s.lastPos.X() / norm;
+  o[DirY] = s.lastPos.Y() / norm;
+  o[DirZ] = s.lastPos.Z() / norm;
+  o[MomX] = s.lastMom.X();
+  o[MomY] = s.lastMom.Y();
+  o[MomZ] = s.lastMom.Z();
+  o[ClosestX] = s.closest.pos.X();
+  o[ClosestY] = s.closest.pos.Y();
+  o[ClosestZ] = s.closest.pos.Z();
+  return o;
+}
+
+BeamTransport::Jacobian BeamTransport::jacobian(const Particle& p, double delta) const {
+  if(!(delta > 0.))
+    throw std::invalid_argument("The finite difference offset must be positive.");
+
+  Jacobian jac;
+  for(unsigned c=0; c<2; ++c) {
+    Particle lo = p, hi = p;
+    if(c == 0) {
+      lo.pos.SetX(p.pos.X() - delta);
+      hi.pos.SetX(p.pos.X() + delta);
+    }
+    else {
+      lo.pos.SetY(p.pos.Y() - delta);
+      hi.pos.SetY(p.pos.Y() + delta);
+    }
+    const Outcomes olo = outcomes(lo), ohi = outcomes(hi);
+    for(unsigned k=0; k<NOUT; ++k)
+      jac(k, c) = (ohi[k] - olo[k]) / (2*delta);
+  }
+  return jac;
+}
+
+BeamTransport::Moments BeamTransport::transport(const Particle& beam, const Sigma& sigma, double delta) const {
+  Moments m;
+  m.mean = outcomes(beam);
+  m.cov = ROOT::Math::Similarity(jacobian(beam, delta), sigma);
+  return m;
+}
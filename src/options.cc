@@ -0,0 +1,141 @@
+#include "include/options.h"
+
+#include <sstream>
+#include <thread>
+
+po::options_description run_options() {
+  po::options_description desc("Options");
+  //https://www.boost.org/doc/libs/1_45_0/doc/html/boost/program_options/typed_value.html#id903171-bb
+  desc.add_options()
+    ("help,h", "produce this help message")
+    ("mode", po::value<std::string>()->default_value("euler"), "numerical solver")
+    ("draw", po::bool_switch(), "whether to draw the geometry with ROOT's Event Display")
+    ("x", po::value<float>(), "initial beam x position")
+    ("y", po::value<float>(), "initial beam y position")
+    ("energy", po::value<float>(), "beam energy position")
+    ("energy_scale", po::value<float>()->default_value(1.f), "factor to scale the energy of the right beam")
+    ("width_scale", po::value<float>()->default_value(1.f), "factor to scale the width of both beams")
+    ("yshift", po::value<float>()->default_value(0.f), "factor to shift the y central value of the beam")
+    ("fermi_shift", po::value<float>()->default_value(0.f), "factor to shift fermi momentum ")
+    ("mass_interaction", po::value<float>()->default_value(0.938), "modelled interaction mass [GeV]")
+    ("npartons", po::value<unsigned>()->default_value(1), "number of partons in a proton colliding")
+    ("nparticles", po::value<unsigned>()->default_value(1), "number of particles to generate on each beam")
+    ("zcutoff", po::value<float>()->default_value(5000.f), "cutoff at which to apply the fake deflection")
+    ("output", po::value<std::string>()->default_value("csv"), "comma-separated formats of the per-event output: 'csv', 'root' and/or 'bin' ('both' = 'csv,root', 'none' disables it)")
+    ("histos", po::bool_switch(), "fill the distributions during the run and write them to data/hists_*.csv")
+    ("histo_bins", po::value<unsigned>()->default_value(100), "number of bins of the '--histos' distributions")
+    ("hit_range", po::value<float>()->default_value(20.f), "the hit distributions of '--histos' span [-hit_range, hit_range] [cm]")
+    ("mom_range", po::value<float>()->default_value(2.f), "the transverse momentum sums of '--histos' span [-mom_range, mom_range] [GeV/c]")
+    ("fermi_range", po::value<float>()->default_value(1.f), "the Fermi momentum distribution of '--histos' spans [-fermi_range, fermi_range] [GeV/c]")
+    ("flow", po::bool_switch(), "accumulate the directed flow estimators during the run and write them to data/flow_*.csv")
+    ("closest_to", po::value<std::string>()->default_value("0,0,0"), "reference of the closest approach of the tracks: 'x,y,z' for a point or 'x,y,z,dx,dy,dz' for a line [cm]")
+    ("zdc", po::bool_switch(), "place the ALICE zero degree calorimeters and write where the spectators hit them to data/calo_*.csv")
+    ("acceptance_map", po::value<std::string>()->default_value(""), "acceptance map written by acceptance_map.exe: pairs whose spectator cannot reach its calorimeters are not tracked nor stored")
+    ("fastsim", po::bool_switch(), "interpolate the tracking outcomes from a table over the initial beam positions instead of tracking every particle")
+    ("fastsim_nodes", po::value<unsigned>()->default_value(17), "number of table nodes along x and y for '--fastsim'")
+    ("fastsim_check", po::value<unsigned>()->default_value(100), "number of random particles tracked to report the '--fastsim' interpolation error")
+    ("scan", po::value<Vec<std::string>>()->multitoken()->composing(), "scan a parameter in this process: 'name=v1,v2,...' (repeat it for a grid over several parameters)")
+    ("scan_file", po::value<std::string>()->default_value(""), "CSV file with one scan configuration per row and the parameter names as header")
+    ("scan_workers", po::value<unsigned>()->default_value(std::max(1u, std::thread::hardware_concurrency())), "number of scan configurations (or requests of '--serve') run at once")
+    ("scan_name", po::value<std::string>()->default_value("scan"), "name of the scan outputs data/scan_<name>_histo.csv and data/scan_<name>_index.csv")
+    ("track_cache", po::value<unsigned>()->default_value(1024), "memory [MB] of the tracks shared by the configurations of a scan or the requests of '--serve' (0 disables it)")
+    ("seed", po::value<unsigned>()->default_value(0), "seed of the random generators (0: nondeterministic; a scan then picks one for all its configurations)")
+    ("moments", po::bool_switch(), "transport the mean and covariance of the beams instead of sampling particles, and print the mean and width of the hits and angles")
+    ("Bscale", po::value<float>()->default_value(1.f), "factor to scale the intensity of every magnet")
+    ("fit", po::bool_switch(), "fit the '--fit_parameters' with Minuit so that the '--fit_histo' distribution matches the one of '--fit_reference'")
+    ("fit_parameters", po::value<std::string>()->default_value("x,y,yshift,width_scale"), "comma-separated parameters of '--fit', among x, y, yshift, width_scale and Bscale")
+    ("fit_reference", po::value<std::string>()->default_value(""), "CSV file with the reference histograms of '--fit', in the format of '--histos'")
+    ("fit_histo", po::value<std::string>()->default_value("PsiA"), "name of the histogram matched by '--fit' (e.g. PsiA, XHit, XHit_YHit)")
+    ("derivatives", po::bool_switch(), "print the mean hits and angles of the sampled pairs with their derivatives with respect to x, y, yshift, width_scale and the field scale")
+    ("serve", po::value<std::string>(), "run as a daemon: accept runs (one line with their options each) on this Unix socket and stream their results back")
+    ("serve_timeout", po::value<float>()->default_value(10.f), "seconds after which a client of '--serve' that stalls a read or write is dropped (0: never)")
+    ("max_memory", po::value<unsigned>()->default_value(2048), "memory budget [MB] of the batches in flight; sets the batch size (at most 1500)")
+    ("mlmc_levels", po::value<unsigned>()->default_value(0), "maximum number of step size levels for the multilevel Monte Carlo estimate (0 disables it)")
+    ("mlmc_refinement", po::value<unsigned>()->default_value(2), "step size ratio between consecutive multilevel Monte Carlo levels")
+    ("mlmc_tolerance", po::value<float>()->default_value(1e-3), "target root mean square error of the multilevel Monte Carlo estimate");
+  return desc;
+}
+
+tracking::TrackMode track_mode(const po::variables_map& vm) {
+  if(!vm.count("mode"))
+    throw std::invalid_argument("Please specify a mode");
+  std::string m_ = boost::any_cast<std::string>(vm["mode"].value());
+  if(m_ == "euler") return tracking::TrackMode::Euler;
+  else if(m_ == "rk4") return tracking::TrackMode::RungeKutta4;
+  else throw std::invalid_argument("This mode is not supported.");
+}
+
+InputArgs input_args(const po::variables_map& vm) {
+  for(const char* o : {"x", "y", "energy"})
+    if(!vm.count(o))
+      throw po::required_option(o);
+
+  InputArgs info;
+  info.draw = boost::any_cast<bool>(vm["draw"].value());
+  info.histos = boost::any_cast<bool>(vm["histos"].value());
+  info.histo_bins = boost::any_cast<unsigned>(vm["histo_bins"].value());
+  info.hit_range = boost::any_cast<float>(vm["hit_range"].value());
+  info.mom_range = boost::any_cast<float>(vm["mom_range"].value());
+  info.fermi_range = boost::any_cast<float>(vm["fermi_range"].value());
+  info.flow = boost::any_cast<bool>(vm["flow"].value());
+  info.zdc = boost::any_cast<bool>(vm["zdc"].value());
+  info.acceptance_map = boost::any_cast<std::string>(vm["acceptance_map"].value());
+  info.fastsim = boost::any_cast<bool>(vm["fastsim"].value());
+  info.fastsim_nodes = boost::any_cast<unsigned>(vm["fastsim_nodes"].value());
+  info.fastsim_check = boost::any_cast<unsigned>(vm["fastsim_check"].value());
+  if(info.fastsim and info.draw)
+    throw std::invalid_argument("The fast simulation does not produce trajectories to draw.");
+  if(info.fastsim and info.fastsim_nodes < 2)
+    throw std::invalid_argument("The fast simulation needs at least two nodes along x and y.");
+  info.x = boost::any_cast<float>(vm["x"].value());
+  info.y = boost::any_cast<float>(vm["y"].value());
+  info.energy = boost::any_cast<float>(vm["energy"].value());
+  info.energy_scale = boost::any_cast<float>(vm["energy_scale"].value());
+  info.width_scale = boost::any_cast<float>(vm["width_scale"].value());
+  info.yshift = boost::any_cast<float>(vm["yshift"].value());
+  info.fermi_shift = boost::any_cast<float>(vm["fermi_shift"].value());
+  info.mass = 0.938; //GeV
+  info.mass_interaction = boost::any_cast<float>(vm["mass_interaction"].value()); //GeV
+  info.npartons = boost::any_cast<unsigned>(vm["npartons"].value()); //GeV
+  info.nparticles = boost::any_cast<unsigned>(vm["nparticles"].value());
+  info.zcutoff = boost::any_cast<float>(vm["zcutoff"].value());
+  info.max_memory = boost::any_cast<unsigned>(vm["max_memory"].value());
+  std::stringstream closest_(boost::any_cast<std::string>(vm["closest_to"].value()));
+  Vec<double> ref_;
+  for(std::string c; std::getline(closest_, c, ',');)
+    ref_.push_back(std::stod(c));
+  if(ref_.size() == 3)
+    info.approach = ApproachReference::point(XYZ(ref_[0], ref_[1], ref_[2]));
+  else if(ref_.size() == 6)
+    info.approach = ApproachReference::line(XYZ(ref_[0], ref_[1], ref_[2]), XYZ(ref_[3], ref_[4], ref_[5]));
+  else
+    throw std::invalid_argument("The closest approach reference needs 3 (point) or 6 (line) values.");
+  info.mlmc_levels = boost::any_cast<unsigned>(vm["mlmc_levels"].value());
+  info.mlmc_refinement = boost::any_cast<unsigned>(vm["mlmc_refinement"].value());
+  info.mlmc_tolerance = boost::any_cast<float>(vm["mlmc_tolerance"].value());
+  info.csv_output = info.root_output = info.bin_output = false;
+  std::string output_ = boost::any_cast<std::string>(vm["output"].value());
+  std::stringstream outputs_(output_ == "both" ? "csv,root" : output_);
+  for(std::string o; std::getline(outputs_, o, ',');) {
+    if(o == "csv") info.csv_output = true;
+    else if(o == "root") info.root_output = true;
+    else if(o == "bin") info.bin_output = true;
+    else if(o == "none") continue;
+    else throw std::invalid_argument("This output format is not supported.");
+  }
+  assert(info.zcutoff > 0);
+  info.scan_workers = boost::any_cast<unsigned>(vm["scan_workers"].value());
+  info.scan_name = boost::any_cast<std::string>(vm["scan_name"].value());
+  info.track_cache = boost::any_cast<unsigned>(vm["track_cache"].value());
+  info.seed = boost::any_cast<unsigned>(vm["seed"].value());
+  info.moments = boost::any_cast<bool>(vm["moments"].value());
+  if(info.moments and (info.draw or info.histos or info.flow or info.fastsim or info.mlmc_levels > 0))
+    throw std::invalid_argument("'--moments' does not sample particles: it cannot be combined with '--draw', '--histos', '--flow', '--fastsim' nor '--mlmc_levels'.");
+  info.derivatives = boost::any_cast<bool>(vm["derivatives"].value());
+  info.Bscale = boost::any_cast<float>(vm["Bscale"].value());
+  info.fit_reference = boost::any_cast<std::string>(vm["fit_reference"].value());
+  info.fit_histo = boost::any_cast<std::string>(vm["fit_histo"].value());
+  if(info.derivatives and (info.moments or info.draw or info.histos or info.flow or info.fastsim or info.mlmc_levels > 0))
+    throw std::invalid_argument("'--derivatives' tracks the pairs on its own: it cannot be combined with '--moments', '--draw', '--histos', '--flow', '--fastsim' nor '--mlmc_levels'.");
+  return info;
+}
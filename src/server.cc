@@ -0,0 +1,229 @@
+#include "include/server.h"
+
+#include <atomic>
+#include <cerrno>
+#include <chrono>
+#include <cstring>
+#include <sstream>
+#include <stdexcept>
+#include <thread>
+
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/time.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include "TROOT.h"
+
+UnixServer::UnixServer(const std::string& pPath, int pBacklog) : mPath(pPath) {
+  sockaddr_un addr{};
+  if(mPath.empty() or mPath.size() >= sizeof(addr.sun_path))
+    throw std::invalid_argument("Invalid socket path: '" + mPath + "'.");
+  addr.sun_family = AF_UNIX;
+  std::strncpy(addr.sun_path, mPath.c_str(), sizeof(addr.sun_path) - 1);
+
+  mFd = ::socket(AF_UNIX, SOCK_STREAM, 0);
+  if(mFd < 0)
+    throw std::runtime_error(std::string("Failed to create a socket: ") + std::strerror(errno));
+  //a socket left by a previous server is replaced, any other file is left alone
+  struct stat st;
+  if(::lstat(mPath.c_str(), &st) == 0) {
+    if(!S_ISSOCK(st.st_mode)) {
+      ::close(mFd);
+      throw std::invalid_argument("Refusing to replace " + mPath + ": it exists and is not a socket.");
+    }
+    ::unlink(mPath.c_str());
+  }
+  else if(errno != ENOENT) {
+    const std::string err = std::strerror(errno);
+    ::close(mFd);
+    throw std::runtime_error("Failed to inspect " + mPath + ": " + err);
+  }
+  if(::bind(mFd, reinterpret_cast<const sockaddr*>(&addr), sizeof(addr)) < 0 or ::listen(mFd, pBacklog) < 0) {
+    const std::string err = std::strerror(errno);
+    ::close(mFd);
+    throw std::runtime_error("Failed to listen on " + mPath + ": " + err);
+  }
+}
+
+UnixServer::~UnixServer() {
+  ::close(mFd);
+  ::unlink(mPath.c_str());
+}
+
+int UnixServer::accept(double timeout) const {
+  while(true) {
+    const int fd = ::accept(mFd, nullptr, nullptr);
+    if(fd >= 0) {
+      if(timeout > 0.) {
+	timeval tv{};
+	tv.tv_sec = static_cast<time_t>(timeout);
+	tv.tv_usec = static_cast<suseconds_t>((timeout - tv.tv_sec) * 1e6);
+	if(::setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv)) < 0
+	   or ::setsockopt(fd, SOL_SOCKET, SO_SNDTIMEO, &tv, sizeof(tv)) < 0) {
+	  const std::string err = std::strerror(errno);
+	  ::close(fd);
+	  throw std::runtime_error("Failed to set the timeouts of a connection: " + err);
+	}
+      }
+      return fd;
+    }
+    if(errno != EINTR and errno != ECONNABORTED)
+      throw std::runtime_error(std::string("Failed to accept a connection: ") + std::strerror(errno));
+  }
+}
+
+SocketStream::Buffer::Buffer(int pFd) : mFd(pFd), mIn(1 << 12), mOut(1 << 16) {
+  setg(mIn.data(), mIn.data(), mIn.data());
+  setp(mOut.data(), mOut.data() + mOut.size());
+}
+
+//writes the whole output area; false once the peer is gone
+bool SocketStream::Buffer::send_() {
+  const char* p = pbase();
+  while(p < pptr()) {
+    const ssize_t n = ::send(mFd, p, pptr() - p, MSG_NOSIGNAL); //no SIGPIPE when the client left
+    if(n < 0 and errno == EINTR)
+      continue;
+    if(n <= 0)
+      return false;
+    p += n;
+  }
+  setp(mOut.data(), mOut.data() + mOut.size());
+  return true;
+}
+
+SocketStream::Buffer::int_type SocketStream::Buffer::overflow(int_type c) {
+  if(!send_())
+    return traits_type::eof();
+  if(!traits_type::eq_int_type(c, traits_type::eof())) {
+    *pptr() = traits_type::to_char_type(c);
+    pbump(1);
+  }
+  return traits_type::not_eof(c);
+}
+
+SocketStream::Buffer::int_type SocketStream::Buffer::underflow() {
+  ssize_t n;
+  do
+    n = ::recv(mFd, mIn.data(), mIn.size(), 0);
+  while(n < 0 and errno == EINTR);
+  if(n <= 0)
+    return traits_type::eof();
+  setg(mIn.data(), mIn.data(), mIn.data() + n);
+  return traits_type::to_int_type(*gptr());
+}
+
+int SocketStream::Buffer::sync() {
+  return send_() ? 0 : -1;
+}
+
+SocketStream::SocketStream(int pFd) : std::iostream(nullptr), mFd(pFd), mBuffer(pFd) {
+  rdbuf(&mBuffer);
+}
+
+SocketStream::~SocketStream() {
+  mBuffer.pubsync();
+  ::close(mFd);
+}
+
+std::string serve_request(const std::string& line, std::ostream& conn, unsigned iRequest,
+			  const po::options_description& desc, unsigned nworkers, const ContextLookup& context)
+{
+  try {
+    po::variables_map vm;
+    po::store(po::command_line_parser(po::split_unix(line)).options(desc).run(), vm);
+    po::notify(vm);
+    const tracking::TrackMode mode = track_mode(vm);
+    InputArgs a = input_args(vm);
+    if(a.draw or a.histos or a.mlmc_levels > 0 or a.root_output or a.bin_output or vm.count("scan")
+       or !boost::any_cast<std::string>(vm["scan_file"].value()).empty()
+       or boost::any_cast<bool>(vm["fit"].value()) or vm.count("serve"))
+      throw std::invalid_argument("A request runs one configuration with CSV output: '--draw', '--histos', '--mlmc_levels', '--fit', scans and root/bin output are not supported.");
+    a.scan_workers = nworkers; //the requests in flight share the memory budget of the batches
+    const SharedContext& ctx = context(a);
+
+    ScanOutput out;
+    if(a.csv_output and !a.moments and !a.derivatives) {
+      out.histo = std::make_unique<CSVWriter>(conn);
+      Vec<std::string> header = {"iScan"};
+      for(const std::string& c : HistoRecord::columns())
+	header.push_back(c);
+      out.histo->header(header);
+    }
+    if(a.moments)
+      run_moments(mode, a, ctx, &out, iRequest);
+    else if(a.derivatives)
+      run_derivatives(mode, a, ctx, &out, iRequest);
+    else
+      run(mode, a, ctx, &out, iRequest);
+    if(out.histo) {
+      out.histo->close();
+      conn << "\n";
+    }
+    conn << scan_index_header(a.flow, a.moments, a.derivatives) << "\n" << out.index.front().second << std::endl;
+    return "done";
+  }
+  catch(const std::exception& e) {
+    const std::string status = std::string("error: ") + e.what();
+    conn << status << std::endl;
+    return status;
+  }
+}
+
+void serve(const po::options_description& desc, const std::string& path, unsigned nworkers, unsigned trackCache, float timeout)
+{
+  /*
+    Keeps the geometry, the interaction graph, the acceptance maps and the tracks in memory and
+    runs the requests of local clients, 'nworkers' at once. A client connects to the Unix socket
+    'path' and sends one line with the options of a run, as on the command line (one configuration
+    with CSV output: no '--draw', '--histos', '--mlmc_levels', '--fit', scan nor root/bin output).
+    It reads back, as in a scan with the request number as 'iScan':
+      - the 'histo' rows (header first), streamed batch by batch, followed by an empty line
+        (not for '--moments' and '--derivatives', nor without CSV output);
+      - the index header and the index row of the run.
+    A request that fails ends with the line 'error: <reason>'. A client that blocks a read or write
+    of its connection for more than 'timeout' seconds is dropped. The server runs until it is killed.
+  */
+  ROOT::EnableThreadSafety();
+  UnixServer server(path);
+
+  //built by the first request with these calorimeters and acceptance map
+  SharedContexts contexts(trackCache);
+  const ContextLookup context = [&contexts](const InputArgs& a) -> const SharedContext& { return contexts.get(a); };
+
+  std::atomic<unsigned> nextRequest{0};
+  auto handle = [&](SocketStream& conn) {
+		  std::string line;
+		  if(!std::getline(conn, line))
+		    return;
+		  const unsigned iRequest = nextRequest++;
+		  const auto start = std::chrono::steady_clock::now();
+		  const std::string status = serve_request(line, conn, iRequest, desc, nworkers, context);
+		  const std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+		  std::ostringstream log;
+		  log << "Request " << iRequest << " (" << elapsed.count() << " s): " << line << " -> " << status << "\n";
+		  std::cout << log.str() << std::flush;
+		};
+
+  std::cout << " --- Server --- " << std::endl;
+  std::cout << "Socket: " << server.path() << std::endl;
+  std::cout << "Workers: " << nworkers << std::endl;
+  std::cout << "--------------------------" << std::endl;
+  Vec<std::thread> workers;
+  for(unsigned w=0; w<nworkers; ++w)
+    workers.emplace_back([&] {
+			   try {
+			     while(true) {
+			       SocketStream conn(server.accept(timeout));
+			       handle(conn);
+			     }
+			   }
+			   catch(const std::exception& e) {
+			     std::cerr << e.what() << std::endl;
+			   }
+			 });
+  for(auto& t : workers)
+    t.join();
+}
@@ -0,0 +1,1354 @@
+#include "include/simulation.h"
+#include "include/arena.h"
+#include "include/fastsim.h"
+#include "include/generator.h"
+#include "include/kinematics.h"
+#include "include/lattice.h"
+#include "include/mlmc.h"
+#include "include/moments.h"
+#include "include/pipeline.h"
+#include "include/treewriter.h"
+#include "include/tqdm.h"
+
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <atomic>
+#include <chrono>
+#include <numeric>
+#include <thread>
+
+#include "Math/Factory.h"
+#include "Math/Functor.h"
+#include "Math/Minimizer.h"
+#include "TROOT.h"
+#include "TVector3.h"
+
+#include "TRandom.h"
+
+namespace {
+//entry point of a spectator in a calorimeter (global coordinates)
+struct CaloHit {
+public:
+  float x;
+  float y;
+  bool accepted;
+};
+
+////////////////////////////////////////////
+//one batch of particle pairs travelling through the stages of 'run'
+//The vectors keep their capacity when the batch is recycled.
+////////////////////////////////////////////
+struct Batch {
+public:
+  unsigned index;
+  unsigned size;
+  Vec<Particle> p1, p2;
+  Vec<double> angle12;
+  Vec<unsigned char> reachable; //whether the pair can reach the calorimeters of the acceptance map
+  Vec<SimParticle> simp1, simp2;
+  Vec<Track> tracks1, tracks2; //full trajectories, only kept for drawing
+  Vec<TrackSummary> summaries1, summaries2;
+  Vec<HistoRecord> records;
+  Vec<float> weights; //one per record: its interaction probability when weighted instead of drawn, else 1
+  Vec<CaloHit> caloHits; //one per calorimeter and record (record after record)
+};
+
+//whether the particle can reach a calorimeter of 'map' from its initial state
+//(always true if it moves towards the other side)
+bool can_reach(const AcceptanceMap& map, const Particle& p) {
+  if((p.mom.Z() < 0 ? -1 : 1) != map.side())
+    return true;
+  return map.reachable({{ p.pos.X(), p.pos.Y(), p.mom.X()/p.mom.Z(), p.mom.Y()/p.mom.Z(),
+			  std::sqrt(p.mom.Mag2()) }}) != 0;
+}
+
+//particle at the centre of the beam starting from the negative (side -1) or positive (side +1)
+//z end, where 'run' generates the particles of that beam
+Particle beam_centre(const InputArgs& args, int side) {
+  const float energy = args.energy / static_cast<float>(args.npartons);
+  Particle p;
+  p.pos = XYZ( args.x, args.y + args.yshift, side * (args.zcutoff+50) ); // cm
+  p.mom = XYZ( 0., 0., -side * (side > 0 ? args.energy_scale : 1.f) * calc_momentum(energy, args.mass) ); // GeV/c
+  p.mass = args.mass; // GeV/c^2
+  p.energy = energy;
+  p.charge = +1;
+  return p;
+}
+
+////////////////////////////////////////////
+//unit vectors of the planes of the spectator positions of each beam
+//Normal to the line from the nominal beam position at -+zcutoff to the
+//interaction point: uX is TVector3::Orthogonal of the normal and uY is uX
+//rotated by pi/2 around it.
+////////////////////////////////////////////
+struct DetectorPlanes {
+public:
+  TVector3 uX1, uY1; //negative z side
+  TVector3 uX2, uY2; //positive z side
+};
+
+DetectorPlanes detector_planes(const InputArgs& args) {
+  auto axes = [](TVector3 uZ, TVector3& uX, TVector3& uY) {
+		uZ = uZ.Unit();
+		uX = uZ.Orthogonal();
+		uY = uX;
+		uY.Rotate( M_PI/2, uZ );
+		assert( (M_PI/2) - uX.Angle(uY) < 1e-15 );
+	      };
+  DetectorPlanes planes;
+  axes(TVector3(-args.x, -args.y, args.zcutoff), planes.uX1, planes.uY1);
+  axes(TVector3(-args.x, -args.y, -args.zcutoff), planes.uX2, planes.uY2);
+  if(planes.uX1.Dot(planes.uY1) > 1e-15 or planes.uX2.Dot(planes.uY2) > 1e-15) {
+    std::ostringstream msg;
+    msg << "The unit vectors of the detector planes must be perpendicular (dot products "
+	<< planes.uX1.Dot(planes.uY1) << ", " << planes.uX2.Dot(planes.uY2) << ").";
+    throw std::runtime_error(msg.str());
+  }
+  return planes;
+}
+
+//parameters of a run in the names of its output files ('.' written as 'p')
+std::string run_suffix(tracking::TrackMode mode, const InputArgs& args, double stepsize) {
+  const std::array<std::string, tracking::TrackMode::NMODES> suf = {{ "_euler", "_rk4" }};
+  auto str = [](auto value, std::size_t length) {
+	       std::string s = std::to_string(value).substr(0, length);
+	       std::replace( s.begin(), s.end(), '.', 'p');
+	       return s;
+	     };
+  const std::string str_initpos = "_" + str(args.x, 8) + "X_" + str(args.y, 8) + "Y_" + str(args.energy, 10) + "En_"
+    + str(args.energy_scale, 5) + "EnScale_" + str(args.width_scale, 5) + "WScale_" + str(args.yshift, 5) + "YShift_"
+    + str(args.fermi_shift, 5) + "FShift_";
+  const std::string extra = str(stepsize, std::string::npos) + "SZ_" + str(args.mass_interaction, 8) + "MInt_"
+    + str(args.npartons, 8) + "NP";
+  return suf[mode] + str_initpos + extra;
+}
+
+unsigned size_last_batch(unsigned nbatches, unsigned nelems, unsigned batchSize) {
+  return nelems-(nbatches-1)*batchSize;
+}
+
+unsigned batch_size(const InputArgs& args, unsigned nsteps, unsigned nBatchesInFlight) {
+  /*
+    Largest batch (up to the nominal 1500 pairs) for which all the batches in flight
+    fit in the '--max_memory' budget. Without drawing the tracks are only summarised
+    and a pair costs a few hundred bytes; drawing keeps every step of both tracks.
+  */
+  constexpr std::size_t maxBatchSize = 1500;
+  std::size_t bytesPerPair = 2*(sizeof(Particle) + sizeof(SimParticle) + sizeof(TrackSummary))
+    + sizeof(double) + sizeof(HistoRecord);
+  if(args.draw)
+    bytesPerPair += 2 * nsteps * (2*sizeof(XYZ) + sizeof(double));
+  const std::size_t budget = static_cast<std::size_t>(args.max_memory) << 20; //MB
+  return std::clamp<std::size_t>(budget / (nBatchesInFlight * bytesPerPair), 1, maxBatchSize);
+}
+
+//parameters of a scan configuration: the first columns of its index row (see 'scan_index_header')
+void write_scan_config(std::ostream& row, unsigned iScan, const InputArgs& args) {
+  row << iScan << "," << args.x << "," << args.y << "," << args.energy << "," << args.energy_scale << ","
+      << args.width_scale << "," << args.yshift << "," << args.fermi_shift << "," << args.mass_interaction << ","
+      << args.npartons << "," << args.nparticles << "," << args.Bscale;
+}
+
+Vec<double> split_values(const std::string& str) {
+  std::stringstream ss(str);
+  Vec<double> values;
+  for(std::string v; std::getline(ss, v, ',');)
+    values.push_back(std::stod(v));
+  return values;
+}
+}
+
+float calc_momentum(float en, float mass) {
+  return TMath::Sqrt(en*en - mass*mass);
+}
+
+SharedContext::SharedContext(const InputArgs& args)
+  : magnets(magnet_lattice()), calos(args.zdc ? zdc_calos() : Vec<Calo>{}),
+    tables(std::make_unique<TrackTableCache>(magnets)),
+    boltzmann(BoltzmannDistribution<float>::table(1.f, 0.15, 4, 0.138)), fermi(FermiDistribution<float>::table()) {
+  //read TGraph with interaction probabilities (taken from interaction area)
+  graphFile.reset(TFile::Open("tgraph.root"));
+  if (!graphFile)
+    throw std::runtime_error("Failed to open tgraph.root");
+  graph = (TGraph*)graphFile->Get("prob_graph");
+  if (!graph)
+    throw std::runtime_error("There is no 'prob_graph' in tgraph.root");
+
+  //Process the TGraph
+  const double* xvals = graph->GetX();
+  for(int i = 0; i<graph->GetN(); ++i) {
+    if(xmin > xvals[i])
+      xmin = xvals[i];
+    if(xmax < xvals[i])
+      xmax = xvals[i];
+  }
+
+  //pairs whose spectator can never reach the calorimeters of the map are not tracked
+  if(!args.acceptance_map.empty())
+    acceptance = std::make_unique<AcceptanceMap>(AcceptanceMap::read(args.acceptance_map));
+}
+
+void SharedContext::cache_tracks(unsigned megabytes) {
+  tracks = megabytes > 0 ? std::make_unique<SummaryCache>(magnets, (std::size_t(megabytes) << 20) / SummaryCache::mEntrySize) : nullptr;
+}
+
+const SharedContext& SharedContexts::get(const InputArgs& args) {
+  std::lock_guard<std::mutex> lock(mMutex);
+  std::unique_ptr<SharedContext>& ctx = mContexts[std::make_pair(args.zdc, args.acceptance_map)];
+  if(!ctx) {
+    ctx = std::make_unique<SharedContext>(args);
+    ctx->cache_tracks(mTrackCache);
+  }
+  return *ctx;
+}
+
+void run(tracking::TrackMode mode, const InputArgs& args, const SharedContext& ctx,
+	 ScanOutput* scan, unsigned iScan, RunResults* results)
+{
+  using XYZ = ROOT::Math::XYZVector;
+
+  const double Bscale = args.Bscale;
+  const bool quiet = scan or results;
+  TrackDisplay* display = args.draw ? ctx.display : nullptr;
+  if(args.draw and !display)
+    throw std::invalid_argument("'--draw' needs the event display, which this executable is built without (see display.h).");
+  const tracking::StepSettings steps = tracking::step_settings(mode, args.zcutoff);
+  //per-run output files, e.g. data/histo_euler_<parameters>.csv (only named when one is opened)
+  auto run_file = [&](const std::string& prefix, const std::string& extension) {
+		    return "data/" + prefix + run_suffix(mode, args, steps.stepsize) + extension;
+		  };
+    
+  //generate random positions around input positions
+  //With a seed every generator draws its own reproducible stream, so runs with the same
+  //seed start from the same particles (and can share their tracks, see SummaryCache).
+  NormalDistribution<double> xdist(args.x, args.width_scale * 0.1, stream_seed(args.seed, 1)); //beam width of 1 millimeter
+  NormalDistribution<double> ydist(args.y + args.yshift, args.width_scale * 0.1, stream_seed(args.seed, 2)); //beam width of 1 millimeter
+  BoltzmannDistribution<float> boltzdist(ctx.boltzmann, stream_seed(args.seed, 3));
+  FermiDistribution<float> fermidist(ctx.fermi, stream_seed(args.seed, 4));
+  if(!quiet)
+    FermiDistribution<float>(ctx.fermi).test("data/fermi.csv"); //does not consume the stream of the run
+  UniformDistribution<float> phidist(-M_PI, M_PI, stream_seed(args.seed, 5));
+  UniformDistribution<float> thetadist(0, M_PI, stream_seed(args.seed, 6));
+  UniformDistribution<float> etadist(-2.f, 2.f, stream_seed(args.seed, 7));
+  UniformDistribution<float> decisiondist(0.f, 1.f, stream_seed(args.seed, 8)); //interaction decision
+
+  const MagnetSystem& magnets = ctx.magnets;
+  const CaloSystem& calos = ctx.calos;
+  const TGraph* graph = ctx.graph;
+  const double xmin = ctx.xmin, xmax = ctx.xmax;
+  const AcceptanceMap* acceptance = ctx.acceptance.get();
+  if(acceptance and !(acceptance->tracking() == AcceptanceMap::Tracking{mode, args.zcutoff, args.Bscale}))
+    throw std::invalid_argument("The acceptance map was built for another mode, '--zcutoff' or '--Bscale' (see acceptance_map.exe).");
+  unsigned long nSkipped = 0;
+
+  //with equal beam energies in a mirror symmetric lattice, the positive z beam retraces the
+  //negative z one in a mirror: a beam 2 track is the reflection of the track of the beam 1
+  //particle at the same (x, y), so both beams share the tabulated propagations
+  const bool mirrored = args.energy_scale == 1.f and magnets.mirror_symmetric() and args.approach.mirror_symmetric();
+
+  //tracking outcomes tabulated over the initial positions of each beam (+-5 widths)
+  //(shared by the configurations of a scan and the evaluations of a fit that leave them unchanged)
+  std::shared_ptr<const TrackTable> table1, table2;
+  if(args.fastsim) {
+    const float sigma = args.width_scale * 0.1;
+    //same starting plane and momentum as in 'generate'
+    const Particle tmpl1 = beam_centre(args, -1), tmpl2 = beam_centre(args, +1);
+    auto axes = [&](const Particle& t) {
+		  const double p = std::sqrt(t.mom.Mag2());
+		  return std::array<TrackTable::Axis,TrackTable::NVARS>{{
+		      {args.fastsim_nodes, args.x - 5*sigma, args.x + 5*sigma},
+		      {args.fastsim_nodes, args.y + args.yshift - 5*sigma, args.y + args.yshift + 5*sigma},
+		      {1, 0., 0.}, {1, 0., 0.}, {1, p, p} }};
+		};
+    table1 = ctx.tables->get(tmpl1, axes(tmpl1), mode, steps.nsteps, steps.stepsize, Bscale, args.zcutoff, args.approach);
+    if(!mirrored)
+      table2 = ctx.tables->get(tmpl2, axes(tmpl2), mode, steps.nsteps, steps.stepsize, Bscale, args.zcutoff, args.approach);
+
+    if(!quiet) {
+      std::cout << " --- Fast simulation --- " << std::endl;
+      std::cout << "Nodes per beam: " << table1->size() << std::endl;
+      std::mt19937 checkRng(12345);
+      for(const TrackTable* t : {table1.get(), table2.get()}) {
+	if(!t)
+	  continue;
+	const TrackTable::ErrorReport r = t->validate(args.fastsim_check, checkRng);
+	std::cout << (t == table1.get() ? "Beam 1" : "Beam 2") << " vs tracking (" << r.nsamples << " samples):" << std::endl;
+	for(unsigned k=0; k<r.max.size(); ++k)
+	  std::cout << "  " << r.names[k] << ": max " << r.max[k] << ", rms " << r.rms[k] << std::endl;
+      }
+      std::cout << "--------------------------" << std::endl;
+    }
+  }
+
+  if(display)
+    display->geometry(magnets, calos, args.zcutoff);
+  
+  //batches alive at once in the pipeline; drawing and scans (one configuration per worker) run them one by one
+  const unsigned nBatchesInFlight = args.draw or scan ? 1 : 4;
+  const unsigned batchSize = batch_size(args, steps.nsteps, scan ? args.scan_workers : nBatchesInFlight);
+  const unsigned nbatches = (args.nparticles + batchSize - 1) / batchSize;
+  if(!quiet) {
+    std::cout << " --- Simulation Information --- " << std::endl;
+    std::cout << "Batch Size: " << batchSize << " (last batch: " << size_last_batch(nbatches, args.nparticles, batchSize) << ")" << std::endl;
+    std::cout << "Number of batches: " << nbatches << std::endl;
+    std::cout << "Step Size: " << steps.stepsize << std::endl;
+    std::cout << "Mirror symmetric beams: " << (mirrored ? "yes" : "no") << std::endl;
+    std::cout << "--------------------------" << std::endl;
+  }
+
+  //rows are written on a background thread while the next batch is tracked
+  //(a scan writes them to its single output instead)
+  const unsigned nOutputBuffers = 3;
+  std::unique_ptr<CSVWriter> file2;
+  if(args.csv_output and !quiet) {
+    file2 = std::make_unique<CSVWriter>(run_file("histo", ".csv"), CSVWriter::mDefaultBufferSize, nOutputBuffers);
+    file2->header(HistoRecord::columns());
+  }
+  std::unique_ptr<TreeWriter> tree2;
+  if(args.root_output and !quiet) {
+    TreeWriter::enable_implicit_mt();
+    tree2 = std::make_unique<TreeWriter>(run_file("histo", ".root"));
+  }
+  //flat binary output, spilled batch by batch and assembled on closing
+  std::unique_ptr<EventFileWriter> bin2;
+  if(args.bin_output and !quiet)
+    bin2 = std::make_unique<EventFileWriter>(run_file("histo", ".bin"));
+  //calorimeter hits of the accepted events, matched to the 'histo' rows by (iBatch, Idx)
+  std::unique_ptr<CSVWriter> caloFile;
+  if(args.csv_output and calos.size() > 0 and !quiet) {
+    caloFile = std::make_unique<CSVWriter>(run_file("calo", ".csv"));
+    Vec<std::string> header = {"iBatch", "Idx"};
+    for(const Calo& c : calos.calos())
+      for(std::string col : {"_X", "_Y", "_Hit"})
+	header.push_back(c.label + col);
+    caloFile->header(header);
+  }
+  Vec<unsigned long> caloAccepted(calos.size(), 0);
+  unsigned long nRecords = 0;
+  HistoColumns columns2; //kept in memory to be handed to 'results'
+  V1Histograms histos(args, results and results->histos and results->histos->smooth);
+  //smooth histograms (the fits) keep every reachable pair weighted with its interaction probability
+  //instead of drawing whether it interacts: with the same random numbers, a small change of the
+  //parameters must not move whole records in or out of the histograms
+  const bool weighted = histos.smooth;
+  if(weighted and (results->records or results->flow))
+    throw std::invalid_argument("The records and flow estimators need the interaction draw: they cannot be kept with smooth histograms.");
+  FlowAccumulator flow;
+  const bool keepRecords = results and results->records;
+  const bool fillHistos = args.histos or (results and results->histos);
+  const bool fillFlow = args.flow or (results and results->flow);
+      
+  //unit vectors
+  const DetectorPlanes planes = detector_planes(args);
+  const TVector3& uX1 = planes.uX1;
+  const TVector3& uY1 = planes.uY1;
+  const TVector3& uX2 = planes.uX2;
+  const TVector3& uY2 = planes.uY2;
+
+  ////////////////////////////////////////////
+  //stages of the simulation of one batch
+  //Each stage only touches its own generators and outputs, so that
+  //different batches can be in different stages at the same time.
+  ////////////////////////////////////////////
+
+  //per-batch temporaries of the analysis stage (the other stages reuse the vectors of Batch)
+  //the 'analysis' temporaries of one batch: 4 ThreeVectors, 6 FourVectors and 11 single
+  //arrays of doubles per event, plus a ThreeVectors and a flag per event and calorimeter
+  constexpr std::size_t nAnalysisArrays = 4*kinematics::ThreeVectors::narrays + 6*kinematics::FourVectors::narrays + 11;
+  const std::size_t analysisEventBytes = nAnalysisArrays*sizeof(double)
+    + calos.size()*(kinematics::ThreeVectors::narrays*sizeof(double) + sizeof(unsigned char));
+  const std::size_t analysisSlack = 64 * (nAnalysisArrays + 5*calos.size()) + calos.size()*sizeof(kinematics::ThreeVectors); //alignment, calo vectors
+  Arena analysisArena(batchSize*analysisEventBytes + analysisSlack);
+
+  //define the initial properties of the incident particles
+  const Particle centre1 = beam_centre(args, -1), centre2 = beam_centre(args, +1);
+  auto generate = [&](Batch& b) {
+		    b.size = b.index==nbatches-1 ? size_last_batch(nbatches, args.nparticles, batchSize) : batchSize;
+		    b.p1.resize(b.size);
+		    b.p2.resize(b.size);
+		    b.angle12.resize(b.size); //measure angle between the two particles
+		    for(unsigned i=0; i<b.size; ++i) {
+		      //negative z side
+		      b.p1[i] = centre1;
+		      b.p1[i].pos.SetX( xdist.generate() );
+		      b.p1[i].pos.SetY( ydist.generate() );
+		      //positive z side
+		      b.p2[i] = centre2;
+		      b.p2[i].pos.SetX( xdist.generate() );
+		      b.p2[i].pos.SetY( ydist.generate() );
+
+		      double angle_left  = TMath::ATan( b.p1[i].pos.Y() / args.zcutoff );
+		      double angle_right = TMath::ATan( b.p2[i].pos.Y() / args.zcutoff );
+		      b.angle12[i] = angle_left + angle_right;
+		    }
+		  };
+
+  auto track = [&](Batch& b) {
+		 b.simp1.clear();
+		 b.simp2.clear();
+		 b.simp1.reserve(b.size);
+		 b.simp2.reserve(b.size);
+		 for(unsigned i=0; i<b.size; ++i) {
+		   b.simp1.push_back( SimParticle(b.p1[i], steps.nsteps, steps.stepsize, args.approach) );
+		   b.simp2.push_back( SimParticle(b.p2[i], steps.nsteps, steps.stepsize, args.approach) );
+		 }
+
+		 b.reachable.assign(b.size, 1);
+		 if(acceptance)
+		   for(unsigned i=0; i<b.size; ++i) {
+		     b.reachable[i] = can_reach(*acceptance, b.p1[i]) and can_reach(*acceptance, b.p2[i]);
+		     nSkipped += !b.reachable[i];
+		   }
+
+		 b.summaries1.assign(b.size, TrackSummary{});
+		 b.summaries2.assign(b.size, TrackSummary{});
+		 if(args.draw) { //the event display needs every step
+		   b.tracks1.resize(b.size);
+		   b.tracks2.resize(b.size);
+		   for(unsigned i=0; i<b.size; ++i) {
+		     if(!b.reachable[i]) {
+		       b.tracks1[i] = b.tracks2[i] = Track();
+		       continue;
+		     }
+		     b.tracks1[i] = b.simp1[i].track( magnets, mode, Bscale, args.zcutoff );
+		     b.tracks2[i] = b.simp2[i].track( magnets, mode, Bscale, args.zcutoff );
+		     b.summaries1[i] = b.tracks1[i].summary();
+		     b.summaries2[i] = b.tracks2[i].summary();
+		   }
+		 }
+		 else if(args.fastsim) {
+		   for(unsigned i=0; i<b.size; ++i) {
+		     if(!b.reachable[i])
+		       continue;
+		     b.summaries1[i] = table1->summarize( b.p1[i] );
+		     b.summaries2[i] = mirrored ? mirror_z(table1->summarize( mirror_z(b.p2[i]) )) : table2->summarize( b.p2[i] );
+		   }
+		 }
+		 else if(ctx.tracks) {
+		   for(unsigned i=0; i<b.size; ++i) {
+		     if(!b.reachable[i])
+		       continue;
+		     b.summaries1[i] = ctx.tracks->summarize( b.simp1[i], mode, Bscale, args.zcutoff );
+		     b.summaries2[i] = ctx.tracks->summarize( b.simp2[i], mode, Bscale, args.zcutoff );
+		   }
+		 }
+		 else {
+		   for(unsigned i=0; i<b.size; ++i) {
+		     if(!b.reachable[i])
+		       continue;
+		     b.summaries1[i] = b.simp1[i].summarize( magnets, mode, Bscale, args.zcutoff );
+		     b.summaries2[i] = b.simp2[i].summarize( magnets, mode, Bscale, args.zcutoff );
+		   }
+		 }
+	       };
+
+  //fermi boost of the spectators and kinematics of the produced particle; fills the accepted records
+  //The random numbers are drawn per particle, the physics runs on whole arrays (see kinematics.h).
+  auto analysis = [&](Batch& b) {
+		    using kinematics::ThreeVectors;
+		    using kinematics::FourVectors;
+		    analysisArena.reset(); //the temporaries of the previous batch are gone
+		    std::pmr::memory_resource* mem = analysisArena.resource();
+		    const unsigned n = b.size;
+		    const XYZ ux1(uX1.X(), uX1.Y(), uX1.Z()), uy1(uY1.X(), uY1.Y(), uY1.Z());
+		    const XYZ ux2(uX2.X(), uX2.Y(), uX2.Z()), uy2(uY2.X(), uY2.Y(), uY2.Z());
+
+		    ThreeVectors last1(n, mem), last2(n, mem), lastMom2(n, mem);
+		    FourVectors lastMom1(n, mem), fermi(n, mem), boltz(n, mem);
+		    FourVectors closest1(n, mem), closest2(n, mem), momSum(n, mem);
+
+		    //std::pair<float,float> nomAngles = calculate_angles_to_beamline(args.x, args.y, args.zcutoff);
+
+		    for(unsigned i=0; i<n; ++i) {
+		      const TrackSummary& track1 = b.summaries1[i]; //negative z side
+		      const TrackSummary& track2 = b.summaries2[i]; //positive z side
+
+		      if(b.reachable[i]) { //skipped pairs have empty summaries
+			XYZ check1(-b.p1[i].pos.X(), -b.p1[i].pos.Y(), args.zcutoff);
+			if( kinematics::angle(check1, track1.lastPos) > 1e-7 ) {
+			  throw std::runtime_error("The trajectory is not as it should! Angle1: " +
+						   std::to_string(kinematics::angle(check1, track1.lastPos)));
+			}
+			XYZ check2(-b.p2[i].pos.X(), -b.p2[i].pos.Y(), -args.zcutoff);
+			if( kinematics::angle(check2, track2.lastPos) > 1e-7 ) {
+			  throw std::runtime_error("The trajectory is not as it should! Angle2: " +
+						   std::to_string(kinematics::angle(check2, track2.lastPos)));
+			}
+
+			//check if the two particles "crossed"
+			//this catches number of iterations that are too small
+			assert(track1.lastPos.Z() > track2.lastPos.Z());
+		      }
+
+		      last1.set(i, track1.lastPos);
+		      last2.set(i, track2.lastPos);
+		      lastMom1.p.set(i, track1.lastMom);
+		      lastMom1.e[i] = args.energy;
+		      lastMom2.set(i, track2.lastMom);
+		      closest1.p.set(i, track1.closest.mom);
+		      closest2.p.set(i, track2.closest.mom);
+
+		      //fermi momentum correction (as TVector3::SetPtThetaPhi, then scaled to the generated momentum)
+		      float fermiMom = fermidist.generate();
+		      Double_t fermiPhi = phidist.generate();
+		      Double_t fermiTheta = thetadist.generate();
+		      const double tanTheta = std::tan(fermiTheta);
+		      XYZ fermiVec(std::cos(fermiPhi), std::sin(fermiPhi), tanTheta != 0. ? 1. / tanTheta : 0.);
+		      fermiVec *= fermiMom/std::sqrt(fermiVec.Mag2());
+		      fermiVec.SetY(fermiVec.Y() + args.fermi_shift);
+		      fermi.p.set(i, fermiVec);
+		    }
+
+		    //produced particle (as TLorentzVector::SetPtEtaPhiM)
+		    const float mass_pion = 0.139;
+		    for(unsigned i=0; i<n; ++i) {
+		      float boltzgen = boltzdist.generate();
+		      float etagen = etadist.generate();
+		      float phigen = phidist.generate();
+		      boltz.p.set(i, XYZ(boltzgen*std::cos(phigen), boltzgen*std::sin(phigen), boltzgen*std::sinh(etagen)));
+		    }
+
+		    //hits distribution without fermi boost
+		    PVec<double> xHitNoBoost(n, mem), yHitNoBoost(n, mem);
+		    kinematics::direction_dot(last1, ux1, Globals::distanceToDetector, xHitNoBoost.data());
+		    kinematics::direction_dot(last1, uy1, Globals::distanceToDetector, yHitNoBoost.data());
+
+		    //fermi boost along the spectator momentum
+		    ThreeVectors beta(n, mem);
+		    kinematics::set_mass(fermi, args.mass);
+		    PVec<double> fermiPzBeforeBoost(fermi.p.z, mem);
+		    kinematics::boost_vectors(lastMom1, beta);
+		    kinematics::boost(fermi, beta);
+		    PVec<double> xHit(n, mem), yHit(n, mem);
+		    kinematics::direction_dot(fermi.p, ux1, Globals::distanceToDetector, xHit.data());
+		    kinematics::direction_dot(fermi.p, uy1, Globals::distanceToDetector, yHit.data());
+
+		    //spectator planes
+		    PVec<double> lastX(n, mem), lastY(n, mem), psi1(n, mem), psi2(n, mem);
+		    kinematics::dot(last1, ux1, lastX.data());
+		    kinematics::dot(last1, uy1, lastY.data());
+		    kinematics::atan2(lastY.data(), lastX.data(), n, psi1.data());
+		    kinematics::dot(last2, ux2, lastX.data());
+		    kinematics::dot(last2, uy2, lastY.data());
+		    kinematics::atan2(lastY.data(), lastX.data(), n, psi2.data());
+
+		    //produced particle boosted with the pair at closest approach
+		    kinematics::set_mass(closest1, args.mass);
+		    kinematics::set_mass(closest2, args.mass);
+		    kinematics::add(closest1, closest2, momSum);
+		    //for(...) momSum.e[i] = TMath::Sqrt( sq(momSum.p.x[i]) + sq(momSum.p.y[i]) + sq(momSum.p.z[i]) + sq(args.mass_interaction) );
+		    kinematics::set_mass(boltz, mass_pion);
+		    kinematics::boost_vectors(momSum, beta);
+		    kinematics::boost(boltz, beta);
+		    PVec<double> totalPhis(n, mem), totalEtas(n, mem);
+		    kinematics::phi(boltz.p, totalPhis.data());
+		    kinematics::eta(boltz.p, totalEtas.data());
+
+		    //straight extrapolation of the spectators to the calorimeters on their side
+		    PVec<ThreeVectors> caloHits(mem);
+		    PVec<PVec<unsigned char>> caloAcc(mem); //the inner vectors use the arena too
+		    caloHits.reserve(calos.size());
+		    caloAcc.reserve(calos.size());
+		    for(unsigned ic=0; ic<calos.size(); ++ic) {
+		      caloHits.emplace_back(n, mem);
+		      caloAcc.emplace_back(n, 0);
+		      const Dimensions& d = calos.calos()[ic].dims;
+		      if(d.Z().first + d.Z().second > 0)
+			calos.hits(ic, last1, lastMom1.p, caloHits[ic], caloAcc[ic].data());
+		      else
+			calos.hits(ic, last2, lastMom2, caloHits[ic], caloAcc[ic].data());
+		    }
+
+		    b.records.clear();
+		    b.weights.clear();
+		    b.caloHits.clear();
+		    for(unsigned ix=0; ix<n; ix++) {
+		      float psiA = psi1[ix] + M_PI;
+		      float psiB = psi2[ix] + M_PI;
+
+		      //define categories according to relative angular difference
+		      unsigned cat = 99;
+		      float category_bound = M_PI/6;
+		      float diff = std::abs(psiA-psiB);
+		      if( diff < category_bound or diff > 2*M_PI-category_bound )
+			cat = 1;
+		      else if(diff < M_PI+category_bound and diff > M_PI-category_bound)
+			cat = 2;
+		      else
+			cat = 0;
+
+		      float psiB_tmp = psiB+M_PI>2*M_PI ? psiB-M_PI : psiB+M_PI;
+		      float psi_angle = distance_two_angles(psiA, psiB_tmp);
+		      psi_angle /= 2.;
+
+		      float totalPhi = totalPhis[ix];
+		      float totalEta = totalEtas[ix];
+		      if(totalPhi<0)
+			totalPhi = 2*M_PI + totalPhi; //convert from [-Pi;Pi[ to [0;2Pi[
+			
+		      float corr = std::cos( distance_two_angles(totalPhi, psi_angle) );
+
+		      float decision_prob = -1.f;
+		      if (b.angle12[ix] > xmax)
+			decision_prob = graph->Eval(xmax);
+		      else if(b.angle12[ix] < xmin)
+			decision_prob = 1.f;
+		      else //inside the TGraph's domain
+			decision_prob = graph->Eval( b.angle12[ix] );
+		      const bool interacts = weighted or decisiondist.generate() < decision_prob;
+
+		      if( interacts and b.reachable[ix] ) {
+			b.weights.push_back(weighted ? decision_prob : 1.f);
+			b.records.push_back(HistoRecord{b.index, ix,
+							momSum.p.x[ix], momSum.p.y[ix], momSum.p.z[ix],
+							static_cast<float>(fermiPzBeforeBoost[ix]), static_cast<float>(fermi.p.z[ix]),
+							static_cast<float>(xHitNoBoost[ix]), static_cast<float>(yHitNoBoost[ix]),
+							static_cast<float>(xHit[ix]), static_cast<float>(yHit[ix]),
+							psiA, psiB, cat,
+							psi_angle, totalPhi, totalEta, corr});
+			for(unsigned ic=0; ic<calos.size(); ++ic)
+			  b.caloHits.push_back(CaloHit{static_cast<float>(caloHits[ic].x[ix]),
+						       static_cast<float>(caloHits[ic].y[ix]),
+						       caloAcc[ic][ix] != 0});
+		      }
+		    }
+		  };
+
+  auto output = [&](Batch& b) {
+		  std::unique_lock<std::mutex> scanLock;
+		  if(scan and scan->histo)
+		    scanLock = std::unique_lock<std::mutex>(scan->mutex);
+		  for(unsigned ir=0; ir<b.records.size(); ++ir) {
+		    const HistoRecord& rec = b.records[ir];
+		    if(scanLock)
+		      rec.write(scan->histo->field(iScan));
+		    if(file2)
+		      rec.write(*file2);
+		    if(tree2)
+		      tree2->fill(rec);
+		    if(bin2)
+		      bin2->append(rec);
+		    if(keepRecords)
+		      columns2.append(rec);
+		    if(fillHistos)
+		      histos.fill(rec, b.weights[ir]);
+		    if(fillFlow)
+		      flow.add(rec.phi, rec.psi, rec.psiA, rec.psiB);
+		    if(calos.size() > 0) {
+		      const CaloHit* hits = &b.caloHits[ir*calos.size()];
+		      if(caloFile)
+			caloFile->field(rec.iBatch).field(rec.idx);
+		      for(unsigned ic=0; ic<calos.size(); ++ic) {
+			caloAccepted[ic] += hits[ic].accepted;
+			if(caloFile)
+			  caloFile->field(hits[ic].x).field(hits[ic].y).field(static_cast<unsigned>(hits[ic].accepted));
+		      }
+		      if(caloFile)
+			caloFile->end_line();
+		    }
+		  }
+		  nRecords += b.records.size();
+		  if(file2)
+		    file2->flush(); //hand this batch over to the writer thread
+		  if(caloFile)
+		    caloFile->flush();
+		  if(bin2)
+		    bin2->flush();
+		};
+
+  auto draw = [&](Batch& b) {
+		display->tracks(b.tracks1, b.tracks2, b.reachable);
+
+		//the trajectories are not needed anymore
+		b.tracks1.clear();
+		b.tracks2.clear();
+	      };
+
+  if(scan) {
+    //the scan already runs one configuration per core
+    Batch b;
+    for(unsigned ibatch=0; ibatch<nbatches; ++ibatch) {
+      b.index = ibatch;
+      generate(b);
+      track(b);
+      analysis(b);
+      output(b);
+    }
+  }
+  else if(args.draw) {
+    //the event display needs the full trajectories on the main thread
+    Batch b;
+    for (unsigned ibatch : tq::trange(nbatches)) {
+      b.index = ibatch;
+      generate(b);
+      track(b);
+      draw(b);
+      analysis(b);
+      output(b);
+    }
+  }
+  else {
+    //one thread per stage; the batch being generated, the one being tracked and the one
+    //being written are different. Every stage sees the batches in order, so the
+    //random sequences and the output are the same as in the sequential loop.
+    ROOT::EnableThreadSafety();
+    Vec<Batch> pool(nBatchesInFlight);
+    unsigned nextBatch = 0, batchesDone = 0;
+    tq::progress_bar bar;
+    Pipeline<Batch> pipeline([&](Batch& b) {
+			       if(nextBatch == nbatches)
+				 return false;
+			       b.index = nextBatch++;
+			       generate(b);
+			       return true;
+			     },
+			     {track, analysis},
+			     [&](Batch& b) {
+			       output(b);
+			       if(!quiet)
+				 bar.update(static_cast<double>(++batchesDone) / nbatches);
+			     });
+    pipeline.run(pool);
+    if(!quiet)
+      std::cerr << std::endl;
+  }
+
+  if(file2)
+    file2->close();
+  if(caloFile)
+    caloFile->close();
+  if(tree2)
+    tree2->close();
+  if(bin2)
+    bin2->close();
+  if(results) {
+    if(results->histos)
+      *results->histos = std::move(histos);
+    if(results->records)
+      *results->records = std::move(columns2);
+    if(results->flow)
+      *results->flow = flow;
+    return;
+  }
+  if(args.histos)
+    histos.write(run_file("hists", ".csv"));
+  if(scan) {
+    //configuration, number of rows and flow estimators (see 'scan_index_header')
+    std::ostringstream row;
+    row.precision(10);
+    write_scan_config(row, iScan, args);
+    row << "," << nRecords << "," << nSkipped;
+    if(args.flow)
+      for(const auto& v : {flow.v1_ep(), flow.v1_sp()})
+	row << "," << v.value << "," << v.error;
+    std::lock_guard<std::mutex> lock(scan->mutex);
+    scan->index.emplace_back(iScan, row.str());
+    return;
+  }
+
+  if(args.flow) {
+    flow.write(run_file("flow", ".csv"));
+    std::cout << " --- Directed flow --- " << std::endl;
+    std::cout << "v1{EP}: " << flow.v1_ep().value << " +- " << flow.v1_ep().error << std::endl;
+    std::cout << "v1{SP}: " << flow.v1_sp().value << " +- " << flow.v1_sp().error << std::endl;
+    std::cout << "--------------------------" << std::endl;
+  }
+
+  if(acceptance)
+    std::cout << "Pairs skipped with the acceptance map: " << nSkipped << " / " << args.nparticles << std::endl;
+  if(calos.size() > 0) {
+    std::cout << " --- Calorimeter acceptance --- " << std::endl;
+    for(unsigned ic=0; ic<calos.size(); ++ic)
+      std::cout << calos.calos()[ic].label << ": " << caloAccepted[ic] << " / " << nRecords << std::endl;
+    std::cout << "--------------------------" << std::endl;
+  }
+
+  if(display)
+    display->show();
+}
+
+////////////////////////////////////////////
+//beam moments instead of sampled particles
+////////////////////////////////////////////
+const Vec<std::string>& moment_quantities() {
+  static const Vec<std::string> q = {"XHitNoBoost", "YHitNoBoost", "PsiA", "PsiB", "Angle12"};
+  return q;
+}
+
+void run_moments(tracking::TrackMode mode, const InputArgs& args, const SharedContext& ctx,
+		 ScanOutput* scan, unsigned iScan)
+{
+  /*
+    Transports the mean and covariance of both beams instead of sampling them (see BeamTransport)
+    and derives the mean and standard deviation of the hit positions without the Fermi boost, of the
+    spectator plane angles PsiA and PsiB and of the angle between the beams 'angle12'.
+    The quantities are linearised around the beam centres: the beam width must be small compared
+    with the distance of the centres to the axis, where the spectator planes become undefined.
+  */
+  using XYZ = ROOT::Math::XYZVector;
+  using BT = BeamTransport;
+  const tracking::StepSettings steps = tracking::step_settings(mode, args.zcutoff);
+  const double Bscale = args.Bscale;
+  const double sigma = args.width_scale * 0.1; //beam width of 1 millimeter
+  const double delta = std::max(1e-6, 1e-2 * sigma); //finite difference offset [cm]
+
+  //particles at the centre of each beam, as in 'run'
+  const Particle beam1 = beam_centre(args, -1), beam2 = beam_centre(args, +1);
+
+  BT::Sigma cov;
+  cov(0,0) = cov(1,1) = sigma*sigma;
+  const BT transport(ctx.magnets, mode, steps.nsteps, steps.stepsize, Bscale, args.zcutoff, args.approach);
+  const BT::Moments m1 = transport.transport(beam1, cov, delta);
+  const BT::Moments m2 = transport.transport(beam2, cov, delta);
+
+  //unit vectors
+  const DetectorPlanes planes = detector_planes(args);
+  auto xyz = [](const TVector3& v) { return XYZ(v.X(), v.Y(), v.Z()); };
+  const XYZ ux1 = xyz(planes.uX1), uy1 = xyz(planes.uY1);
+  const XYZ ux2 = xyz(planes.uX2), uy2 = xyz(planes.uY2);
+
+  //the quantities only depend on the direction of the last position
+  auto direction = [](const BT::Moments& m) { return XYZ(m.mean[BT::DirX], m.mean[BT::DirY], m.mean[BT::DirZ]); };
+  auto gradient = [](const XYZ& g) {
+		    BT::Outcomes o;
+		    o[BT::DirX] = g.X();
+		    o[BT::DirY] = g.Y();
+		    o[BT::DirZ] = g.Z();
+		    return o;
+		  };
+  //as 'kinematics::direction_dot'
+  auto hit = [&](const BT::Moments& m, const XYZ& u) {
+	       const double d = Globals::distanceToDetector;
+	       return m.propagate(d * direction(m).Dot(u), gradient(d * u));
+	     };
+  //atan2(dir.uy, dir.ux) + pi
+  auto psi = [&](const BT::Moments& m, const XYZ& ux, const XYZ& uy) {
+	       const double a = direction(m).Dot(ux), b = direction(m).Dot(uy);
+	       return m.propagate(std::atan2(b, a) + M_PI, gradient((a*uy - b*ux) / (a*a + b*b)));
+	     };
+  //sum of the independent atan(y/zcutoff) of both beams
+  const double ymean = args.y + args.yshift;
+  const double dangle = 1. / (args.zcutoff * (1. + ymean*ymean / (args.zcutoff*args.zcutoff)));
+  const std::pair<double,double> angle12(2 * std::atan(ymean / args.zcutoff), std::sqrt(2.) * dangle * sigma);
+
+  const Vec<std::pair<double,double>> results = {hit(m1, ux1), hit(m1, uy1), psi(m1, ux1, uy1), psi(m2, ux2, uy2), angle12};
+  if(scan) {
+    std::ostringstream row;
+    row.precision(10);
+    write_scan_config(row, iScan, args);
+    row << ",0,0";
+    for(const auto& r : results)
+      row << "," << r.first << "," << r.second;
+    std::lock_guard<std::mutex> lock(scan->mutex);
+    scan->index.emplace_back(iScan, row.str());
+    return;
+  }
+
+  std::cout << " --- Beam moments --- " << std::endl;
+  for(unsigned k=0; k<results.size(); ++k) {
+    std::cout << moment_quantities()[k] << ": " << results[k].first << " +- " << results[k].second;
+    if(moment_quantities()[k].rfind("Psi", 0) == 0 and results[k].second > 0.5)
+      std::cout << " (not Gaussian: the beam is too close to the axis, sample it instead)";
+    std::cout << std::endl;
+  }
+  std::cout << "--------------------------" << std::endl;
+}
+
+////////////////////////////////////////////
+//derivatives of the quantities with respect to the beam parameters
+////////////////////////////////////////////
+namespace derivatives {
+  const Vec<std::string>& parameters() {
+    static const Vec<std::string> p = {"x", "y", "yshift", "width_scale", "Bscale"};
+    return p;
+  }
+
+  //unit vectors of the spectator plane, as 'uX1' and 'uY1' in 'run' (TVector3::Orthogonal, then rotated by pi/2)
+  std::pair<Vec3<D>, Vec3<D>> plane_axes(const D& x, const D& y, double z) {
+    using std::sqrt;
+    const Vec3<D> uZ = Vec3<D>(-x, -y, z) / sqrt(x*x + y*y + z*z);
+    const double ax = std::abs(uZ.x.v), ay = std::abs(uZ.y.v), az = std::abs(uZ.z.v);
+    Vec3<D> uX;
+    if(ax < ay)
+      uX = ax < az ? Vec3<D>(0., uZ.z, -uZ.y) : Vec3<D>(uZ.y, -uZ.x, 0.);
+    else
+      uX = ay < az ? Vec3<D>(-uZ.z, 0., uZ.x) : Vec3<D>(uZ.y, -uZ.x, 0.);
+    return std::make_pair(uX, uZ.Cross(uX));
+  }
+}
+
+void run_derivatives(tracking::TrackMode mode, const InputArgs& args, const SharedContext& ctx,
+		     ScanOutput* scan, unsigned iScan)
+{
+  /*
+    Mean of the hit positions without the Fermi boost, of the spectator plane angles PsiA and PsiB
+    and of the angle between the beams 'angle12' over the sampled pairs, with its derivatives with
+    respect to x, y, yshift, width_scale and the field scale Bscale (see SimParticle::differentiate).
+    The pairs are those of 'run' with the same seed: an initial position is x + width*xi with a fixed
+    xi, so the derivatives are those of the sample mean for the same random numbers.
+  */
+  using P = derivatives::Parameter;
+  using D = derivatives::D;
+  using TG = TrackGradient;
+  const tracking::StepSettings steps = tracking::step_settings(mode, args.zcutoff);
+  const double Bscale = args.Bscale;
+  const double d = Globals::distanceToDetector;
+
+  NormalDistribution<double> xdist(0., 1., stream_seed(args.seed, 1));
+  NormalDistribution<double> ydist(0., 1., stream_seed(args.seed, 2));
+
+  const D x = D::variable(args.x, P::X);
+  const D y = D::variable(args.y, P::Y);
+  const D yshift = D::variable(args.yshift, P::YShift);
+  const D width = 0.1 * D::variable(args.width_scale, P::WidthScale);
+  const D zc(args.zcutoff);
+  const auto axes1 = derivatives::plane_axes(x, y, args.zcutoff);
+  const auto axes2 = derivatives::plane_axes(x, y, -args.zcutoff);
+
+  //initial transverse position of a beam particle
+  auto position = [&](const D& mean, double xi) { return mean + width * xi; };
+  //derivatives of the tracking outcome 't' with respect to the parameters
+  auto chain = [](const TG::D& t, const D& x0, const D& y0) {
+		 D r(t.v);
+		 for(unsigned i=0; i<P::NPARS; ++i)
+		   r.d[i] = t.d[TG::X] * x0.d[i] + t.d[TG::Y] * y0.d[i];
+		 r.d[P::Bscale] += t.d[TG::SCALE];
+		 return r;
+	       };
+  auto last_position = [&](const Particle& p, const D& x0, const D& y0) {
+			 const TG g = SimParticle(p, steps.nsteps, steps.stepsize, args.approach).differentiate(ctx.magnets, mode, Bscale, args.zcutoff);
+			 return Vec3<D>(chain(g.lastPos.x, x0, y0), chain(g.lastPos.y, x0, y0), chain(g.lastPos.z, x0, y0));
+		       };
+
+  const Particle centre1 = beam_centre(args, -1), centre2 = beam_centre(args, +1);
+  Vec<D> means(moment_quantities().size());
+  tq::progress_bar bar;
+  for(unsigned i=0; i<args.nparticles; ++i) {
+    const double xi1 = xdist.generate(), eta1 = ydist.generate();
+    const double xi2 = xdist.generate(), eta2 = ydist.generate();
+    const D x1 = position(x, xi1), y1 = position(y + yshift, eta1);
+    const D x2 = position(x, xi2), y2 = position(y + yshift, eta2);
+
+    //as in 'run'
+    Particle p1 = centre1, p2 = centre2;
+    p1.pos.SetX(x1.v);
+    p1.pos.SetY(y1.v);
+    p2.pos.SetX(x2.v);
+    p2.pos.SetY(y2.v);
+
+    const Vec3<D> last1 = last_position(p1, x1, y1), last2 = last_position(p2, x2, y2);
+    const D mag1 = sqrt(last1.Mag2());
+    const D a1 = last1.Dot(axes1.first), b1 = last1.Dot(axes1.second);
+    const D a2 = last2.Dot(axes2.first), b2 = last2.Dot(axes2.second);
+    const Vec<D> q = {d * a1 / mag1, d * b1 / mag1, atan2(b1, a1) + M_PI, atan2(b2, a2) + M_PI,
+		      atan(y1 / zc) + atan(y2 / zc)};
+    for(unsigned k=0; k<q.size(); ++k)
+      means[k] += q[k];
+    if(!scan) //the scan has its own progress bar
+      bar.update(static_cast<double>(i+1) / args.nparticles);
+  }
+  if(!scan)
+    std::cerr << std::endl;
+  for(D& m : means)
+    m /= static_cast<double>(std::max(1u, args.nparticles));
+
+  if(scan) {
+    std::ostringstream row;
+    row.precision(10);
+    write_scan_config(row, iScan, args);
+    row << ",0,0";
+    for(const D& m : means) {
+      row << "," << m.v;
+      for(double g : m.d)
+	row << "," << g;
+    }
+    std::lock_guard<std::mutex> lock(scan->mutex);
+    scan->index.emplace_back(iScan, row.str());
+    return;
+  }
+
+  std::cout << " --- Derivatives --- " << std::endl;
+  for(unsigned k=0; k<means.size(); ++k) {
+    std::cout << moment_quantities()[k] << ": " << means[k].v;
+    for(unsigned i=0; i<P::NPARS; ++i)
+      std::cout << ", d/d" << derivatives::parameters()[i] << " " << means[k].d[i];
+    std::cout << std::endl;
+  }
+  std::cout << "--------------------------" << std::endl;
+}
+
+////////////////////////////////////////////
+//parameter scans in a single process
+////////////////////////////////////////////
+void set_parameter(InputArgs& args, const std::string& name, double value) {
+  if(name == "x") args.x = value;
+  else if(name == "y") args.y = value;
+  else if(name == "energy") args.energy = value;
+  else if(name == "energy_scale") args.energy_scale = value;
+  else if(name == "width_scale") args.width_scale = value;
+  else if(name == "yshift") args.yshift = value;
+  else if(name == "fermi_shift") args.fermi_shift = value;
+  else if(name == "mass_interaction") args.mass_interaction = value;
+  else if(name == "Bscale") args.Bscale = value;
+  else if(name == "npartons" or name == "nparticles") {
+    if(value < 1 or value != std::floor(value))
+      throw std::invalid_argument("The parameter '" + name + "' must be a positive integer.");
+    (name == "npartons" ? args.npartons : args.nparticles) = static_cast<unsigned>(value);
+  }
+  else throw std::invalid_argument("The parameter '" + name + "' cannot be scanned.");
+}
+
+Vec<InputArgs> scan_configurations(const InputArgs& base, const Vec<std::string>& specs, const std::string& filename) {
+  /*
+    Every row of 'filename' (a CSV file whose header names the parameters, '#' starts a comment)
+    combined with every point of the grid spanned by 'specs' ("name=v1,v2,..." each).
+    Parameters that are not given keep the values of 'base'.
+  */
+  Vec<InputArgs> configs = {base};
+  if(!filename.empty()) {
+    std::ifstream f(filename);
+    if(!f.is_open())
+      throw std::runtime_error("Failed to open " + filename);
+    Vec<std::string> names;
+    Vec<InputArgs> rows;
+    for(std::string line; std::getline(f, line);) {
+      line = line.substr(0, line.find('#'));
+      if(line.find_first_not_of(" \t\r") == std::string::npos)
+	continue;
+      if(names.empty()) {
+	std::stringstream ss(line);
+	for(std::string n; std::getline(ss, n, ',');)
+	  names.push_back(n.substr(n.find_first_not_of(' '), n.find_last_not_of(" \r") - n.find_first_not_of(' ') + 1));
+	continue;
+      }
+      const Vec<double> values = split_values(line);
+      if(values.size() != names.size())
+	throw std::invalid_argument("Wrong number of values in the scan file: " + line);
+      InputArgs row = base;
+      for(unsigned i=0; i<names.size(); ++i)
+	set_parameter(row, names[i], values[i]);
+      rows.push_back(row);
+    }
+    configs = rows;
+  }
+
+  for(const std::string& spec : specs) {
+    const std::size_t eq = spec.find('=');
+    if(eq == std::string::npos)
+      throw std::invalid_argument("Scan parameters are given as 'name=v1,v2,...': " + spec);
+    const std::string name = spec.substr(0, eq);
+    const Vec<double> values = split_values(spec.substr(eq+1));
+    Vec<InputArgs> grid;
+    for(const InputArgs& c : configs)
+      for(double v : values) {
+	grid.push_back(c);
+	set_parameter(grid.back(), name, v);
+      }
+    configs = grid;
+  }
+  if(configs.empty())
+    throw std::invalid_argument("The scan has no configuration.");
+  return configs;
+}
+
+std::string scan_index_header(bool flow, bool moments, bool derivatives) {
+  std::string h = "iScan,x,y,energy,energy_scale,width_scale,yshift,fermi_shift,mass_interaction,npartons,nparticles,Bscale,nRecords,nSkipped";
+  if(flow)
+    h += ",v1EP,v1EP_err,v1SP,v1SP_err";
+  if(moments)
+    for(const std::string& q : moment_quantities())
+      h += "," + q + "," + q + "_sigma";
+  if(derivatives)
+    for(const std::string& q : moment_quantities()) {
+      h += "," + q;
+      for(const std::string& p : derivatives::parameters())
+	h += "," + q + "_d" + p;
+    }
+  return h;
+}
+
+void run_scan(tracking::TrackMode mode, const InputArgs& args, Vec<InputArgs> configs)
+{
+  /*
+    Runs every configuration of a scan in this process: the geometry, the interaction
+    probability graph and the acceptance map are read once, and a pool of workers takes
+    the configurations one after the other (each on a single core). The 'histo' rows of
+    all the configurations go to one file with their configuration index 'iScan', and
+    the index file lists the parameters and results of every configuration.
+    All the configurations use the same seed, so those with the same tracking inputs
+    start from the same particles and track them only once (see SummaryCache).
+  */
+  ROOT::EnableThreadSafety();
+  SharedContext ctx(args);
+  ctx.cache_tracks(args.track_cache);
+
+  const std::string basename = "data/scan_" + args.scan_name;
+  ScanOutput out;
+  if(args.csv_output and !args.moments and !args.derivatives) {
+    out.histo = std::make_unique<CSVWriter>(basename + "_histo.csv", CSVWriter::mDefaultBufferSize, 3);
+    Vec<std::string> header = {"iScan"};
+    for(const std::string& c : HistoRecord::columns())
+      header.push_back(c);
+    out.histo->header(header);
+  }
+
+  const unsigned seed = args.seed > 0 ? args.seed : std::max(1u, std::random_device()());
+  for(InputArgs& c : configs)
+    c.seed = seed;
+
+  const unsigned nconfigs = configs.size();
+  const unsigned nworkers = std::max(1u, std::min(args.scan_workers, nconfigs));
+  std::cout << " --- Scan Information --- " << std::endl;
+  std::cout << "Configurations: " << nconfigs << std::endl;
+  std::cout << "Workers: " << nworkers << std::endl;
+  std::cout << "Seed: " << seed << std::endl;
+  std::cout << "--------------------------" << std::endl;
+
+  //the first failure stops the scan and is rethrown once the workers are done
+  std::atomic<unsigned> next{0}, done{0};
+  std::atomic<bool> failed{false};
+  std::exception_ptr error;
+  Vec<std::thread> workers;
+  for(unsigned w=0; w<nworkers; ++w)
+    workers.emplace_back([&] {
+			   for(unsigned i; !failed and (i = next++) < nconfigs; ++done) {
+			     try {
+			       if(args.moments)
+				 run_moments(mode, configs[i], ctx, &out, i);
+			       else if(args.derivatives)
+				 run_derivatives(mode, configs[i], ctx, &out, i);
+			       else
+				 run(mode, configs[i], ctx, &out, i);
+			     }
+			     catch(...) {
+			       std::lock_guard<std::mutex> lock(out.mutex);
+			       if(!error)
+				 error = std::current_exception();
+			       failed = true;
+			     }
+			   }
+			 });
+  tq::progress_bar bar;
+  while(done < nconfigs and !failed) {
+    bar.update(static_cast<double>(done) / nconfigs);
+    std::this_thread::sleep_for(std::chrono::milliseconds(200));
+  }
+  for(auto& t : workers)
+    t.join();
+  bar.update(static_cast<double>(done) / nconfigs);
+  std::cerr << std::endl;
+  if(error)
+    std::rethrow_exception(error);
+
+  if(out.histo)
+    out.histo->close();
+  std::sort(out.index.begin(), out.index.end());
+  std::ofstream index(basename + "_index.csv");
+  if(!index.is_open())
+    throw std::runtime_error("Failed to open " + basename + "_index.csv");
+  index << scan_index_header(args.flow, args.moments, args.derivatives) << std::endl;
+  for(const auto& row : out.index)
+    index << row.second << std::endl;
+  std::cout << "Scan written to " << basename << "_index.csv";
+  if(out.histo)
+    std::cout << " and " << basename << "_histo.csv";
+  std::cout << std::endl;
+  if(ctx.tracks)
+    std::cout << "Tracks reused: " << ctx.tracks->hits() << " / " << ctx.tracks->hits() + ctx.tracks->misses()
+	      << " (" << ctx.tracks->size() << " cached)" << std::endl;
+}
+
+////////////////////////////////////////////
+//fits of the beam parameters to a reference distribution
+////////////////////////////////////////////
+//contents of the histogram 'name' in a file in the format of V1Histograms::write, in the order of its rows
+Vec<double> read_histogram(const std::string& filename, const std::string& name) {
+  std::ifstream f(filename);
+  if(!f.is_open())
+    throw std::runtime_error("Failed to open " + filename);
+  Vec<double> contents;
+  std::string line;
+  std::getline(f, line); //header
+  while(std::getline(f, line))
+    if(line.compare(0, name.size()+1, name + ",") == 0)
+      contents.push_back(std::stod(line.substr(line.rfind(',')+1)));
+  if(contents.empty())
+    throw std::invalid_argument("There is no histogram named '" + name + "' in " + filename);
+  return contents;
+}
+
+//chi2 of the shape of 'sim', normalised to the entries of 'ref', with the errors of both
+//(2*entries of 'ref' when the shapes do not overlap, and for an empty 'sim')
+double shape_chi2(const Vec<double>& ref, const Vec<double>& sim) {
+  if(ref.size() != sim.size())
+    throw std::invalid_argument("The reference histogram has " + std::to_string(ref.size()) +
+				" bins instead of " + std::to_string(sim.size()) + ".");
+  const double nref = std::accumulate(ref.begin(), ref.end(), 0.);
+  const double nsim = std::accumulate(sim.begin(), sim.end(), 0.);
+  if(nsim == 0.)
+    return 2*nref;
+  const double s = nref / nsim;
+  double chi2 = 0.;
+  for(unsigned b=0; b<ref.size(); ++b)
+    if(ref[b] > 0. or sim[b] > 0.) {
+      const double d = ref[b] - s*sim[b];
+      chi2 += d*d / (ref[b] + s*s*sim[b]);
+    }
+  return chi2;
+}
+
+namespace fitting {
+  //initial step and limits (none when equal) of a fitted parameter
+  struct Range {
+    double step, low, high;
+  };
+  Range range(const std::string& name) {
+    if(name == "x" or name == "y" or name == "yshift") return {0.01, 0., 0.}; //a tenth of the beam width [cm]
+    if(name == "width_scale") return {0.05, 0.01, 100.};
+    if(name == "Bscale") return {0.01, 0., 0.};
+    throw std::invalid_argument("The parameter '" + name + "' cannot be fitted (x, y, yshift, width_scale, Bscale).");
+  }
+
+  double parameter(const InputArgs& args, const std::string& name) {
+    if(name == "x") return args.x;
+    if(name == "y") return args.y;
+    if(name == "yshift") return args.yshift;
+    if(name == "width_scale") return args.width_scale;
+    if(name == "Bscale") return args.Bscale;
+    throw std::invalid_argument("The parameter '" + name + "' cannot be fitted (x, y, yshift, width_scale, Bscale).");
+  }
+
+  //everything an evaluation of the objective needs; built once per fit
+  struct State {
+  public:
+    tracking::TrackMode mode;
+    InputArgs args; //fixed seed: every evaluation draws the same random numbers
+    const SharedContext& ctx;
+    Vec<std::string> names;
+    Vec<double> reference;
+    unsigned ncalls = 0;
+
+    double chi2(const double* par) {
+      InputArgs a = args;
+      for(unsigned i=0; i<names.size(); ++i)
+	set_parameter(a, names[i], par[i]);
+      V1Histograms h(a, true); //continuous in the parameters
+      RunResults r;
+      r.histos = &h;
+      run(mode, a, ctx, nullptr, 0, &r);
+      const double c = shape_chi2(reference, h.contents(a.fit_histo));
+      std::cout << "Call " << ++ncalls << ":";
+      for(unsigned i=0; i<names.size(); ++i)
+	std::cout << " " << names[i] << " " << par[i];
+      std::cout << ", chi2 " << c << std::endl;
+      return c;
+    }
+  };
+}
+
+void run_fit(tracking::TrackMode mode, const InputArgs& args, const Vec<std::string>& names)
+{
+  /*
+    Fits the parameters 'names' (among x, y, yshift, width_scale and Bscale; the others keep
+    their values) with MIGRAD so that the histogram 'fit_histo' of the simulation matches
+    the one of the file 'fit_reference' (written by '--histos', or data in the same format).
+    Every evaluation runs the simulation with the same seed and the geometry, interaction
+    graph, acceptance map and generator tables read once: the objective only changes through
+    the parameters. Every reachable pair enters the simulated histogram weighted with its
+    interaction probability instead of passing the accept/reject draw, and with cloud-in-cell
+    weights, so that the objective is continuous and the finite differences of MIGRAD see
+    neither records switching in or out nor the bin edges.
+  */
+  SharedContext ctx(args);
+  fitting::State state{mode, args, ctx, names, read_histogram(args.fit_reference, args.fit_histo)};
+  state.args.seed = args.seed > 0 ? args.seed : std::max(1u, std::random_device()());
+
+  std::cout << " --- Fit Information --- " << std::endl;
+  std::cout << "Reference: " << args.fit_histo << " in " << args.fit_reference << std::endl;
+  std::cout << "Seed: " << state.args.seed << std::endl;
+  std::cout << "--------------------------" << std::endl;
+
+  const ROOT::Math::Functor objective([&state](const double* par) { return state.chi2(par); }, names.size());
+  std::unique_ptr<ROOT::Math::Minimizer> minimizer(ROOT::Math::Factory::CreateMinimizer("Minuit2", "Migrad"));
+  if(!minimizer)
+    throw std::runtime_error("Minuit2 is not available in this ROOT installation.");
+  minimizer->SetPrintLevel(0);
+  minimizer->SetErrorDef(1.); //chi2
+  minimizer->SetFunction(objective);
+  for(unsigned i=0; i<names.size(); ++i) {
+    const fitting::Range r = fitting::range(names[i]);
+    const double start = fitting::parameter(args, names[i]);
+    if(r.low < r.high)
+      minimizer->SetLimitedVariable(i, names[i], start, r.step, r.low, r.high);
+    else
+      minimizer->SetVariable(i, names[i], start, r.step);
+  }
+  const bool converged = minimizer->Minimize();
+
+  const unsigned nbins = std::count_if(state.reference.begin(), state.reference.end(), [](double c) { return c > 0.; });
+  std::cout << " --- Fit results --- " << std::endl;
+  std::cout << "Status: " << (converged ? "converged" : "failed (" + std::to_string(minimizer->Status()) + ")") << std::endl;
+  for(unsigned i=0; i<names.size(); ++i)
+    std::cout << names[i] << ": " << minimizer->X()[i] << " +- " << minimizer->Errors()[i] << std::endl;
+  std::cout << "chi2 / ndf: " << minimizer->MinValue() << " / " << static_cast<int>(nbins) - static_cast<int>(names.size()) << std::endl;
+  std::cout << "Calls: " << state.ncalls << std::endl;
+  std::cout << "--------------------------" << std::endl;
+}
+
+void run_mlmc(tracking::TrackMode mode, const InputArgs& args, const SharedContext& ctx)
+{
+  /*
+    Estimates the mean PsiA angle of the negative-z beam with multilevel Monte Carlo.
+    Level 0 uses the default step size of the mode; each finer level divides it by
+    --mlmc_refinement, up to --mlmc_levels levels. The field scale, the closest approach
+    reference and the seed are those of 'run'.
+  */
+  const tracking::StepSettings steps = tracking::step_settings(mode, args.zcutoff);
+
+  MultilevelMC mlmc(ctx.magnets, mode, steps.nsteps, steps.stepsize, args.mlmc_levels, args.mlmc_refinement,
+		    args.approach, stream_seed(args.seed, 1));
+
+  std::normal_distribution<double> xdist(args.x, args.width_scale * 0.1);
+  std::normal_distribution<double> ydist(args.y + args.yshift, args.width_scale * 0.1);
+  const Particle centre = beam_centre(args, -1);
+  auto sampler = [&](std::mt19937& rng) {
+		   Particle p = centre;
+		   p.pos.SetX( xdist(rng) );
+		   p.pos.SetY( ydist(rng) );
+		   return p;
+		 };
+
+  const DetectorPlanes planes = detector_planes(args);
+  const TVector3& uX1 = planes.uX1;
+  const TVector3& uY1 = planes.uY1;
+  auto psiA = [&](const TrackSummary& track) {
+		const XYZ& last = track.lastPos;
+		return std::atan2( last.Dot(uY1), last.Dot(uX1) ) + M_PI;
+	      };
+
+  const unsigned npilot = 100;
+  double res = mlmc.estimate(sampler, psiA, args.mlmc_tolerance, npilot, args.Bscale, args.zcutoff);
+
+  std::cout << " --- MLMC Information --- " << std::endl;
+  const unsigned nlevels = mlmc.levels().size();
+  for(unsigned l=0; l<nlevels; ++l) {
+    const auto& lvl = mlmc.levels()[l];
+    std::cout << "Level " << l << ": step size " << mlmc.step_size(l)
+	      << ", samples " << lvl.nsamples
+	      << ", mean " << lvl.mean() << " +- " << mlmc.standard_error(l)
+	      << ", variance " << lvl.variance()
+	      << ", steps/sample " << lvl.cost_per_sample() << std::endl;
+  }
+  const double se = std::sqrt(mlmc.variance());
+  std::cout << "PsiA: " << res << " +- " << se << std::endl;
+  /* the finest correction estimates the bias left by the truncation at level L */
+  if(nlevels > 1) {
+    const double bias = mlmc.bias();
+    std::cout << "Bias check: |E[P_L - P_L-1]| = " << bias << " +- " << mlmc.standard_error(nlevels-1)
+	      << " against standard error " << se << std::endl;
+    if(bias > args.mlmc_tolerance/std::sqrt(2.))
+      std::cout << "Warning: the bias estimate exceeds the tolerance; increase --mlmc_levels." << std::endl;
+  }
+  std::cout << "--------------------------" << std::endl;
+}
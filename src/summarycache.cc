@@ -0,0 +1,79 @@
+#include "include/summarycache.h"
+
+#include <cmath>
+#include <functional>
+#include <mutex>
+
+SummaryCache::SummaryCache(const MagnetSystem& pMagnets, std::size_t pCapacity)
+  : mMagnets(pMagnets), mCapacity(pCapacity) {}
+
+std::size_t SummaryCache::KeyHash::operator()(const Key& k) const {
+  std::size_t h = 0;
+  for(double v : k) //as boost::hash_combine
+    h ^= std::hash<double>()(v) + 0x9e3779b97f4a7c15ULL + (h << 6) + (h >> 2);
+  return h;
+}
+
+std::size_t SummaryCache::size() const {
+  std::lock_guard<std::mutex> lock(mMutex);
+  return mSummaries.size();
+}
+
+TrackSummary SummaryCache::summarize(const SimParticle& simp, tracking::TrackMode mode, double scale, float zcutoff) {
+  const Particle& p = simp.particle();
+  const ApproachReference& ref = simp.reference();
+  //without field the summary is stored for |p| = 1
+  const double norm = mMagnets.field_free(scale) ? std::sqrt(p.mom.Mag2()) : 1.;
+  const Key key = {{ static_cast<double>(mode), static_cast<double>(simp.nsteps()), simp.step_size(), scale, zcutoff,
+		     ref.origin().X(), ref.origin().Y(), ref.origin().Z(),
+		     ref.direction().X(), ref.direction().Y(), ref.direction().Z(),
+		     p.pos.X(), p.pos.Y(), p.pos.Z(),
+		     p.mom.X()/norm, p.mom.Y()/norm, p.mom.Z()/norm,
+		     p.mass, static_cast<double>(p.charge) }};
+
+  std::promise<TrackSummary> promise;
+  {
+    std::unique_lock<std::mutex> lock(mMutex);
+    auto it = mSummaries.find(key);
+    if(it != mSummaries.end()) {
+      ++mHits;
+      mLru.splice(mLru.begin(), mLru, it->second.lru);
+      std::shared_future<TrackSummary> summary = it->second.summary;
+      lock.unlock();
+      TrackSummary s = summary.get(); //waits while another run tracks it
+      s.lastMom *= norm;
+      s.closest.mom *= norm;
+      return s;
+    }
+    ++mMisses;
+    if(mCapacity > 0) {
+      it = mSummaries.emplace(key, Entry{promise.get_future().share(), {}}).first;
+      mLru.push_front(&it->first);
+      it->second.lru = mLru.begin();
+      while(mSummaries.size() > mCapacity) {
+	mSummaries.erase(mSummaries.find(*mLru.back()));
+	mLru.pop_back();
+      }
+    }
+  }
+
+  try {
+    TrackSummary s = simp.summarize(mMagnets, mode, scale, zcutoff);
+    TrackSummary stored = s;
+    stored.lastMom /= norm;
+    stored.closest.mom /= norm;
+    promise.set_value(stored);
+    return s;
+  }
+  catch(...) {
+    //the runs waiting for it get the error; the next one tracks it again
+    promise.set_exception(std::current_exception());
+    std::lock_guard<std::mutex> lock(mMutex);
+    auto it = mSummaries.find(key);
+    if(it != mSummaries.end()) {
+      mLru.erase(it->second.lru);
+      mSummaries.erase(it);
+    }
+    throw;
+  }
+}
@@ -1,54 +1,230 @@
 #include "include/tracking.h"
+#include <algorithm>
+
+namespace {
+  using XYZ = ROOT::Math::XYZVector;
+
+  //follows the distance to the reference; the track is taken as straight between two steps
+  class ApproachFinder {
+  public:
+    explicit ApproachFinder(const ApproachReference& pRef) : mRef(pRef) {}
+
+    void step(const XYZ& pos, const XYZ& mom) {
+      XYZ d1 = mRef.separation(pos);
+      if(mNsteps == 0)
+	update_(std::sqrt(d1.Mag2()), 0., pos, mom);
+      else {
+	//the separation is linear along the segment: minimise |d0 + t*(d1-d0)| for t in [0,1]
+	XYZ dd = d1 - mPrevSep;
+	double t = dd.Mag2() > 0. ? std::clamp(-mPrevSep.Dot(dd) / dd.Mag2(), 0., 1.) : 0.;
+	XYZ d = mPrevSep + t * dd;
+	double distance = std::sqrt(d.Mag2());
+	if(distance < mClosest.distance) {
+	  XYZ m = mPrevMom + t * (mom - mPrevMom);
+	  if(m.Mag2() > 0.)
+	    m *= std::sqrt(mPrevMom.Mag2() / m.Mag2()); //the field does not change |p|
+	  update_(distance, mNsteps-1+t, mPrevPos + t * (pos - mPrevPos), m);
+	}
+      }
+      mPrevSep = d1;
+      mPrevPos = pos;
+      mPrevMom = mom;
+      ++mNsteps;
+    }
+
+    const ClosestApproach& result() const { return mClosest; }
+
+  private:
+    const ApproachReference& mRef;
+    ClosestApproach mClosest;
+    XYZ mPrevSep, mPrevPos, mPrevMom;
+    unsigned mNsteps = 0;
+
+    void update_(double distance, double step, const XYZ& pos, const XYZ& mom) {
+      mClosest.distance = distance;
+      mClosest.step = step;
+      mClosest.pos = pos;
+      mClosest.mom = mom;
+    }
+  };
+
+  //stores every step of the trajectory
+  class TrajectoryRecorder {
+  public:
+    TrajectoryRecorder(unsigned nsteps, const ApproachReference& ref) : mApproach(ref) {
+      mEnergies.reserve(nsteps);
+      mPositions.reserve(nsteps);
+      mMomenta.reserve(nsteps);
+    }
+
+    void step(const Vec3<double>& p, const Vec3<double>& m) {
+      const XYZ pos = p.xyz(), mom = m.xyz();
+      mPositions.push_back(pos);
+      mMomenta.push_back(mom);
+      mApproach.step(pos, mom);
+    }
+    void energy(double e) { mEnergies.push_back(e); }
+
+    Track finish(unsigned nStepsUsed) {
+      return Track(nStepsUsed, std::move(mEnergies), std::move(mPositions), std::move(mMomenta),
+		   mApproach.result());
+    }
+
+  private:
+    std::vector<double> mEnergies;
+    std::vector<XYZ> mPositions;
+    std::vector<XYZ> mMomenta;
+    ApproachFinder mApproach;
+  };
+
+  //keeps only the quantities of TrackSummary, with constant memory
+  class SummaryRecorder {
+  public:
+    explicit SummaryRecorder(const ApproachReference& ref) : mApproach(ref) {}
+
+    void step(const Vec3<double>& p, const Vec3<double>& m) {
+      mSummary.lastPos = p.xyz();
+      mSummary.lastMom = m.xyz();
+      mApproach.step(mSummary.lastPos, mSummary.lastMom);
+    }
+    void energy(double) {}
+
+    TrackSummary finish(unsigned nStepsUsed) {
+      mSummary.nStepsUsed = nStepsUsed;
+      mSummary.closest = mApproach.result();
+      return mSummary;
+    }
+
+  private:
+    TrackSummary mSummary;
+    ApproachFinder mApproach;
+  };
+
+  //keeps the last step with its derivatives
+  class GradientRecorder {
+  public:
+    using D = TrackGradient::D;
+
+    void step(const Vec3<D>& pos, const Vec3<D>& mom) {
+      mGradient.lastPos = pos;
+      mGradient.lastMom = mom;
+    }
+    void energy(double) {}
+
+    TrackGradient finish(unsigned nStepsUsed) {
+      mGradient.nStepsUsed = nStepsUsed;
+      return mGradient;
+    }
+
+  private:
+    TrackGradient mGradient;
+  };
+}
+
+TrackSummary Track::summary() const {
+  TrackSummary s;
+  s.nStepsUsed = mNstepsUsed;
+  if(!mPositions.empty()) {
+    s.lastPos = mPositions.back();
+    s.lastMom = mMomenta.back();
+  }
+  s.closest = mClosest;
+  return s;
+}
 
-SimParticle::XYZ SimParticle::calc_relativistic_velocity(const XYZ& mom, double gamma, double mass) const {
+template <class T>
+Vec3<T> SimParticle::calc_relativistic_velocity(const Vec3<T>& mom, const T& gamma, double mass) const {
   return mom * mSpeedOfLight / ( gamma * mass );
 }
 
-SimParticle::XYZ SimParticle::calc_lorentz_force(double charge, const XYZ& vel, const XYZ& b) const {
+template <class T>
+Vec3<T> SimParticle::calc_lorentz_force(double charge, const Vec3<T>& vel, const Vec3<T>& b) const {
   return charge*vel.Cross(b); // (A*s)*(cm/s)*(kg/(A*s*s)) = (cm*kg)/(s*s)
 }
 
-const Track& SimParticle::track(const MagnetSystem& magnets, tracking::TrackMode mode, double scale, float zcutoff ) & {
+//as PxPyPzMVector::Gamma and PxPyPzMVector::Beta
+template <class T>
+T SimParticle::gamma_(const Vec3<T>& mom) const {
+  using std::sqrt;
+  return sqrt(mom.Mag2() + mParticle.mass*mParticle.mass) / mParticle.mass;
+}
+
+template <class T>
+T SimParticle::beta_(const Vec3<T>& mom) const {
+  using std::sqrt;
+  return sqrt(mom.Mag2() / (mom.Mag2() + mParticle.mass*mParticle.mass));
+}
+
+Track SimParticle::track(const MagnetSystem& magnets, tracking::TrackMode mode, double scale, float zcutoff ) const {
   using m = tracking::TrackMode;
   
-  if(mode == m::Euler) { 
-    if(mTrackCheck[m::Euler] == false) {
-      mTracks[m::Euler] = track_euler(magnets, scale, zcutoff);
-      mTrackCheck[m::Euler] = true;
-    }
-  }
-  
-  else if(mode == m::RungeKutta4) { 
-    if(mTrackCheck[m::RungeKutta4] == false) {
-      mTracks[m::RungeKutta4] = track_rungekutta4(magnets, scale);
-  	mTrackCheck[m::RungeKutta4] = true;
-    }    
-  }
-  
+  TrajectoryRecorder rec(mNsteps, mReference);
+  unsigned nStepsUsed;
+  if(mode == m::Euler)
+    nStepsUsed = track_euler(Vec3<double>(mParticle.pos), Vec3<double>(mParticle.mom), magnets, scale, zcutoff, rec);
+  else if(mode == m::RungeKutta4)
+    nStepsUsed = track_rungekutta4(Vec3<double>(mParticle.pos), Vec3<double>(mParticle.mom), magnets, scale, rec);
   else   
     throw std::invalid_argument("The tracking mode specified is not supported.");
 
-  return mTracks[mode];
+  return rec.finish(nStepsUsed);
+}
+
+const Track& TrackCache::track(const MagnetSystem& magnets, tracking::TrackMode mode, double scale, float zcutoff ) & {
+  if(mode >= tracking::TrackMode::NMODES)
+    throw std::invalid_argument("The tracking mode specified is not supported.");
+  if(!mTracks[mode])
+    mTracks[mode] = mParticle.track(magnets, mode, scale, zcutoff);
+  return *mTracks[mode];
+}
+
+TrackSummary SimParticle::summarize(const MagnetSystem& magnets, tracking::TrackMode mode, double scale, float zcutoff ) const {
+  using m = tracking::TrackMode;
+
+  SummaryRecorder rec(mReference);
+  unsigned nStepsUsed;
+  if(mode == m::Euler)
+    nStepsUsed = track_euler(Vec3<double>(mParticle.pos), Vec3<double>(mParticle.mom), magnets, scale, zcutoff, rec);
+  else if(mode == m::RungeKutta4)
+    nStepsUsed = track_rungekutta4(Vec3<double>(mParticle.pos), Vec3<double>(mParticle.mom), magnets, scale, rec);
+  else
+    throw std::invalid_argument("The tracking mode specified is not supported.");
+
+  return rec.finish(nStepsUsed);
 }
 
-Track SimParticle::track_euler(const MagnetSystem& magnets, double scale, float zcutoff)
+TrackGradient SimParticle::differentiate(const MagnetSystem& magnets, tracking::TrackMode mode, double scale, float zcutoff ) const {
+  using m = tracking::TrackMode;
+  using D = TrackGradient::D;
+
+  const Vec3<D> pos(D::variable(mParticle.pos.X(), TrackGradient::X), D::variable(mParticle.pos.Y(), TrackGradient::Y), mParticle.pos.Z());
+  const Vec3<D> mom(D::variable(mParticle.mom.X(), TrackGradient::PX), D::variable(mParticle.mom.Y(), TrackGradient::PY), mParticle.mom.Z());
+  const D dscale = D::variable(scale, TrackGradient::SCALE);
+
+  GradientRecorder rec;
+  unsigned nStepsUsed;
+  if(mode == m::Euler)
+    nStepsUsed = track_euler(pos, mom, magnets, dscale, zcutoff, rec);
+  else if(mode == m::RungeKutta4)
+    nStepsUsed = track_rungekutta4(pos, mom, magnets, dscale, rec);
+  else
+    throw std::invalid_argument("The tracking mode specified is not supported.");
+
+  return rec.finish(nStepsUsed);
+}
+
+template <class T, class Recorder>
+unsigned SimParticle::track_euler(const Vec3<T>& pos0, const Vec3<T>& mom0, const MagnetSystem& magnets, const T& scale, float zcutoff, Recorder& rec) const
 { 
+  using std::sqrt;
   double charge = mParticle.charge * mEcharge; // C = A*s
 
-  Ltz initLorentzVec( mParticle.mom.X(), mParticle.mom.Y(), mParticle.mom.Z(), mParticle.mass );
-  XYZ partPos = mParticle.pos; //cm
-  XYZ partMom = initLorentzVec.Vect(); // Gev/c
+  Vec3<T> partPos = pos0; //cm
+  Vec3<T> partMom = mom0; // Gev/c
   // p (GeV/c) = beta (c) *gamma*m0 (GeV/c2) -> (cm/s)
-  XYZ partVel = calc_relativistic_velocity(partMom, initLorentzVec.Gamma(), mParticle.mass);
-
-  double deltaT = mStepSize / ( mSpeedOfLight * initLorentzVec.Beta() ); // s
+  Vec3<T> partVel = calc_relativistic_velocity(partMom, gamma_(partMom), mParticle.mass);
 
-  Vec<double> energies;
-  Vec<XYZ> positions;
-  Vec<XYZ> momenta;
-  energies.reserve(mNsteps);
-  positions.reserve(mNsteps);
-  momenta.reserve(mNsteps);
+  T deltaT = mStepSize / ( mSpeedOfLight * beta_(partMom) ); // s
 
   unsigned nStepsUsed = 0;
 
@@ -56,44 +232,43 @@ Track SimParticle::track_euler(const MagnetSystem& magnets, double scale, float
 
   while(nStepsUsed<mNsteps)
     {
-      positions.push_back( partPos);
-      momenta.push_back( partMom );
+      rec.step( partPos, partMom );
 
       // direction to move without magnetic field in cm
-      XYZ posIncr = partMom * ( mStepSize / TMath::Sqrt(partMom.Mag2()) );
+      Vec3<T> posIncr = partMom * ( mStepSize / sqrt(partMom.Mag2()) );
       //XYZ posIncr = partMom * mStepSize;
 
       // new position after deltaT without magnetic field
-      XYZ partPosNext = partPos + posIncr;
+      Vec3<T> partPosNext = partPos + posIncr;
       // center of begin and stop vector without magnetic field
-      XYZ partPosMid = (partPos + partPosNext) * 0.5;
+      Vec3<T> partPosMid = (partPos + partPosNext) * 0.5;
       
-      XYZ Bfield = magnets.field(partPosMid, scale);
+      Vec3<T> Bfield = magnets.field(partPosMid, scale);
 
       if(Bfield.Mag2() == 0.0) {
 	// partPos = partPosNext;
 	
 	//FAKE DEFLECTION, FAKE FORCE
-	if( std::abs(partPos.Z()) < zcutoff and !deviation_done)
+	if( std::abs(value(partPos.z)) < zcutoff and !deviation_done)
 	  {
-	    if(partPos.Z()>0)
-	      partPos.SetXYZ(partPos.X(), partPos.Y(), zcutoff); //ensure it sits exactly at zcutoff
+	    if(partPos.z>0)
+	      partPos.z = zcutoff; //ensure it sits exactly at zcutoff
 	    else
-	      partPos.SetXYZ(partPos.X(), partPos.Y(), -zcutoff); //ensure it sits exactly at zcutoff
+	      partPos.z = -zcutoff; //ensure it sits exactly at zcutoff
 
 	    
 	    // float distToIP = std::sqrt( partPos.Mag2() ); //IP define to be at (0,0,0)
 	    // float angle = std::acos( distCutoff / disitToIP );
-	    XYZ vectorDir = -1 * partPos / TMath::Sqrt( partPos.Mag2() );
+	    Vec3<T> vectorDir = -1. * partPos / sqrt( partPos.Mag2() );
 	
 	    // F = (dp/dt)
-	    XYZ partMomNext = vectorDir * TMath::Sqrt( partMom.Mag2() );
+	    Vec3<T> partMomNext = vectorDir * sqrt( partMom.Mag2() );
 	  
-	    double mag0 = TMath::Sqrt(partMom.Mag2());
-	    double mag1 = TMath::Sqrt(partMomNext.Mag2());
+	    T mag0 = sqrt(partMom.Mag2());
+	    T mag1 = sqrt(partMomNext.Mag2());
 	    partMomNext *= mag0 / mag1; // make sure that total momentum doesn't change
 
-	    XYZ momDelta = partMomNext * ( mStepSize / mag1); // direction to move with magnetic field in cm
+	    Vec3<T> momDelta = partMomNext * ( mStepSize / mag1); // direction to move with magnetic field in cm
 	    partPos += momDelta; // new position after deltaT with magnetic field
 
 	    partMom = partMomNext;
@@ -108,104 +283,93 @@ Track SimParticle::track_euler(const MagnetSystem& magnets, double scale, float
       else
 	{
 	  // F = q*v X B
-	  XYZ force = calc_lorentz_force(charge, partVel, Bfield); // (A*s)*(cm/s)*(kg/(A*s*s)) = (cm*kg)/(s*s)
+	  Vec3<T> force = calc_lorentz_force(charge, partVel, Bfield); // (A*s)*(cm/s)*(kg/(A*s*s)) = (cm*kg)/(s*s)
 
 	  // F = (dp/dt)
-	  XYZ forceDelta = force * deltaT * 1.8708026E16; // (cm*kg)/(s*s) * delta_p (cm*kg)/s -> (GeV/c)
-	  XYZ partMomNext = partMom + forceDelta;
+	  Vec3<T> forceDelta = force * deltaT * 1.8708026E16; // (cm*kg)/(s*s) * delta_p (cm*kg)/s -> (GeV/c)
+	  Vec3<T> partMomNext = partMom + forceDelta;
 	  
-	  double mag0 = TMath::Sqrt(partMom.Mag2());
-	  double mag1 = TMath::Sqrt(partMomNext.Mag2());
+	  T mag0 = sqrt(partMom.Mag2());
+	  T mag1 = sqrt(partMomNext.Mag2());
 	  partMomNext *= mag0 / mag1; // make sure that total momentum doesn't change
 
-	  XYZ momDelta = partMomNext * ( mStepSize / mag1); // direction to move with magnetic field in cm
+	  Vec3<T> momDelta = partMomNext * ( mStepSize / mag1); // direction to move with magnetic field in cm
 	  //XYZ momDelta = partMomNext * mStepSize; // direction to move with magnetic field in cm
 	  partPos += momDelta; // new position after deltaT with magnetic field
 
 	  partMom = partMomNext;
 
 	  // p (GeV/c) = beta (c) *gamma*m0 (GeV/c2) (cm/s)
-	  Ltz tmpLorentz( partMom.X(), partMom.Y(), partMom.Z(), mParticle.mass );
-	  partVel = calc_relativistic_velocity(partMom, tmpLorentz.Gamma(), mParticle.mass);
+	  partVel = calc_relativistic_velocity(partMom, gamma_(partMom), mParticle.mass);
 	}
 
-      energies.push_back( TMath::Sqrt(partMom.Mag2() + 0.938*0.938) );
+      rec.energy( value(sqrt(partMom.Mag2() + 0.938*0.938)) );
       
       ++nStepsUsed;
 
-      if(fabs(partPos.X()) > fabs(mParticle.pos.X()) or fabs(partPos.Y()) > fabs(mParticle.pos.Y())
-      	 or fabs(partPos.Z()) > fabs(mParticle.pos.Z()) ) {
+      if(std::abs(value(partPos.x)) > std::abs(value(pos0.x)) or std::abs(value(partPos.y)) > std::abs(value(pos0.y))
+      	 or std::abs(value(partPos.z)) > std::abs(value(pos0.z)) ) {
       	break;
       }
     }
 
-  return Track(nStepsUsed, energies, positions, momenta);
+  return nStepsUsed;
 }
 
-Track SimParticle::track_rungekutta4(const MagnetSystem& magnets, double scale)
+template <class T, class Recorder>
+unsigned SimParticle::track_rungekutta4(const Vec3<T>& pos0, const Vec3<T>& mom0, const MagnetSystem& magnets, const T& scale, Recorder& rec) const
 {
+  using std::sqrt;
   double charge = mParticle.charge * mEcharge; // C = A*s
 
-  Ltz initLorentzVec( mParticle.mom.X(), mParticle.mom.Y(), mParticle.mom.Z(), mParticle.mass );
-  double deltaT = mStepSize / ( mSpeedOfLight * initLorentzVec.Beta() ); // s
-  XYZ partPos = mParticle.pos; //cm
-  XYZ partMom = initLorentzVec.Vect(); // Gev/c
+  T deltaT = mStepSize / ( mSpeedOfLight * beta_(mom0) ); // s
+  Vec3<T> partPos = pos0; //cm
+  Vec3<T> partMom = mom0; // Gev/c
   // p (GeV/c) = beta (c) *gamma*m0 (GeV/c2) -> (cm/s)
 
-  XYZ partVel = calc_relativistic_velocity(partMom, initLorentzVec.Gamma(), mParticle.mass);
-
-  Vec<double> energies;
-  Vec<XYZ> positions;
-  Vec<XYZ> momenta;
-  energies.reserve(mNsteps);
-  positions.reserve(mNsteps);
-  momenta.reserve(mNsteps);
+  Vec3<T> partVel = calc_relativistic_velocity(partMom, gamma_(partMom), mParticle.mass);
 
   unsigned nStepsUsed = 0;
   while(nStepsUsed<mNsteps)
     {
-      positions.push_back( partPos );
-      momenta.push_back( partMom );
+      rec.step( partPos, partMom );
 
       // direction to move without magnetic field in cm
-      //XYZ posIncr = partMom * ( mStepSize / TMath::Sqrt(partMom.Mag2()) );
-      XYZ posIncr = partVel * mStepSize / TMath::Sqrt(partVel.Mag2());
+      //XYZ posIncr = partMom * ( mStepSize / sqrt(partMom.Mag2()) );
+      Vec3<T> posIncr = partVel * mStepSize / sqrt(partVel.Mag2());
 
       // new position after delta_t without magnetic field
-      XYZ partPosNext = partPos + posIncr;
+      Vec3<T> partPosNext = partPos + posIncr;
       // center of begin and stop vector without magnetic field
-      XYZ partPosMid = (partPos + partPosNext) * 0.5;
+      Vec3<T> partPosMid = (partPos + partPosNext) * 0.5;
 
-      XYZ Bfield = magnets.field(partPosMid, scale);
+      Vec3<T> Bfield = magnets.field(partPosMid, scale);
 
       if(Bfield.Mag2() == 0.0)
 	  partPos = partPosNext;
       else
 	{
 	  // F = q*v X B (runge-kutta k1)
-	  XYZ k1_p = calc_lorentz_force(charge, partVel, Bfield); // (A*s)*(cm/s)*(kg/(A*s*s)) = (cm*kg)/(s*s))
+	  Vec3<T> k1_p = calc_lorentz_force(charge, partVel, Bfield); // (A*s)*(cm/s)*(kg/(A*s*s)) = (cm*kg)/(s*s))
 
 	  //runge-kutta k2 term
-	  XYZ p2 = partMom + mStepSize * k1_p * 0.5;
-	  Ltz ltz2( p2.X(), p2.Y(), p2.Z(), mParticle.mass );
-	  XYZ vel2 = calc_relativistic_velocity(p2, ltz2.Gamma(), mParticle.mass);
-	  XYZ k2_p = calc_lorentz_force(charge, vel2, Bfield); // (A*s)*(cm/s)*(kg/(A*s*s)) = (cm*kg)/(s*s)
+	  Vec3<T> p2 = partMom + mStepSize * k1_p * 0.5;
+	  Vec3<T> vel2 = calc_relativistic_velocity(p2, gamma_(p2), mParticle.mass);
+	  Vec3<T> k2_p = calc_lorentz_force(charge, vel2, Bfield); // (A*s)*(cm/s)*(kg/(A*s*s)) = (cm*kg)/(s*s)
 
 	  //runge-kutta k3 term
-	  XYZ p3 = partMom + mStepSize * k2_p * 0.5;
-	  Ltz ltz3( p3.X(), p3.Y(), p3.Z(), mParticle.mass );
-	  XYZ vel3 = calc_relativistic_velocity(p3, ltz3.Gamma(), mParticle.mass);
-	  XYZ k3_p = calc_lorentz_force(charge, vel3, Bfield); // (A*s)*(cm/s)*(kg/(A*s*s)) = (cm*kg)/(s*s)
+	  Vec3<T> p3 = partMom + mStepSize * k2_p * 0.5;
+	  Vec3<T> vel3 = calc_relativistic_velocity(p3, gamma_(p3), mParticle.mass);
+	  Vec3<T> k3_p = calc_lorentz_force(charge, vel3, Bfield); // (A*s)*(cm/s)*(kg/(A*s*s)) = (cm*kg)/(s*s)
 
 	  //runge-kutta k4 term
-	  XYZ p4 = partMom + mStepSize * k3_p;
-	  Ltz ltz4( p4.X(), p4.Y(), p4.Z(), mParticle.mass );
-	  XYZ vel4 = calc_relativistic_velocity(p4, ltz4.Gamma(), mParticle.mass);
-	  XYZ k4_p = calc_lorentz_force(charge, vel4, Bfield); // (A*s)*(cm/s)*(kg/(A*s*s)) = (cm*kg)/(s*s)
+	  Vec3<T> p4 = partMom + mStepSize * k3_p;
+	  Vec3<T> vel4 = calc_relativistic_velocity(p4, gamma_(p4), mParticle.mass);
+	  Vec3<T> k4_p = calc_lorentz_force(charge, vel4, Bfield); // (A*s)*(cm/s)*(kg/(A*s*s)) = (cm*kg)/(s*s)
 
 	  // (cm*kg)/(s*s) * delta_p (cm*kg)/s -> (GeV/c)
-	  XYZ forceDelta = ( deltaT * 1.8708026E16 * 0.16666666 * (k1_p + 2*k2_p + 2*k3_p + k4_p) );
-	  XYZ partMomNext = partMom + forceDelta;
+	  Vec3<T> forceDelta = ( deltaT * 1.8708026E16 * 0.16666666 * (k1_p + 2*k2_p + 2*k3_p + k4_p) );
+	  Vec3<T> partMomNext = partMom + forceDelta;
 
 	  // std::cerr << nStepsUsed << std::endl;
 	  // std::cerr << "K1: " << k1_p.X() << ", " << k1_p.Y() << ", " << k1_p.Z() << std::endl;
@@ -226,17 +390,16 @@ Track SimParticle::track_rungekutta4(const MagnetSystem& magnets, double scale)
 	  // std::cerr << "Bfield: " << Bfield.X() << ", " << Bfield.Y() << ", " << Bfield.Z() << std::endl;
 
 	  // v = dx/dt = p * c / (gamma * m) (runge-kutta k1 term)
-	  XYZ partPosNext = partPos + ( mStepSize * 0.16666666 * (partVel + 2*vel2 + 2*vel3 + vel4) / TMath::Sqrt(partVel.Mag2()) );
+	  Vec3<T> partPosNext = partPos + ( mStepSize * 0.16666666 * (partVel + 2*vel2 + 2*vel3 + vel4) / sqrt(partVel.Mag2()) );
 	  partPos = partPosNext;
 
 	  // momentum normalization
-	  double mag2 = TMath::Sqrt(partMom.Mag2());
-	  double mag3 = TMath::Sqrt(partMomNext.Mag2());
+	  T mag2 = sqrt(partMom.Mag2());
+	  T mag3 = sqrt(partMomNext.Mag2());
 	  partMomNext *= mag2/mag3;
 	  partMom = partMomNext;
 	  
-	  Ltz ltz_for_next_vel( partMom.X(), partMom.Y(), partMom.Z(), mParticle.mass );
-	  partVel = calc_relativistic_velocity(partMom, ltz_for_next_vel.Gamma(), mParticle.mass);
+	  partVel = calc_relativistic_velocity(partMom, gamma_(partMom), mParticle.mass);
 
 	  // std::cout << "Positions: " << nStepsUsed << ", " << partPos.X() << ", " << partPos.Y() << ", " << partPos.Z() << std::endl;
 	  // std::cout << "Velocities: " << nStepsUsed << ", " << partVel.X() << ", " << partVel.Y() << ", " << partVel.Z() << std::endl;
@@ -244,13 +407,13 @@ Track SimParticle::track_rungekutta4(const MagnetSystem& magnets, double scale)
 
 	}
 
-      energies.push_back( TMath::Sqrt(partMom.Mag2() + 0.938*0.938) );
+      rec.energy( value(sqrt(partMom.Mag2() + 0.938*0.938)) );
       
       ++nStepsUsed;
 
-      if(fabs(partPos.Z()) > 9000.0) break;
+      if(std::abs(value(partPos.z)) > 9000.0) break;
     }
 
-  return Track(nStepsUsed, energies, positions, momenta);
+  return nStepsUsed;
 }
 
@@ -0,0 +1,57 @@
+#include "include/treewriter.h"
+
+#include "Compression.h"
+#include "TROOT.h"
+
+TreeWriter::TreeWriter(const std::string& filename, const std::string& treename)
+  : mFile(TFile::Open(filename.c_str(), "RECREATE", "",
+		      ROOT::CompressionSettings(ROOT::RCompressionSetting::EAlgorithm::kZSTD, 5))) {
+  if(!mFile or mFile->IsZombie())
+    throw std::runtime_error("Failed to open " + filename);
+
+  mTree = new TTree(treename.c_str(), "v1 measurement");
+  mTree->SetDirectory(mFile.get());
+  mTree->SetAutoFlush(-mAutoFlushBytes); //negative: a byte budget rather than a number of entries
+
+  const auto& c = HistoRecord::columns();
+  mTree->Branch(c[0].c_str(),  &mRecord.iBatch);
+  mTree->Branch(c[1].c_str(),  &mRecord.idx);
+  mTree->Branch(c[2].c_str(),  &mRecord.sumMomX);
+  mTree->Branch(c[3].c_str(),  &mRecord.sumMomY);
+  mTree->Branch(c[4].c_str(),  &mRecord.sumMomZ);
+  mTree->Branch(c[5].c_str(),  &mRecord.fermiPzBeforeBoost);
+  mTree->Branch(c[6].c_str(),  &mRecord.fermiPzAfterBoost);
+  mTree->Branch(c[7].c_str(),  &mRecord.xHitNoBoost);
+  mTree->Branch(c[8].c_str(),  &mRecord.yHitNoBoost);
+  mTree->Branch(c[9].c_str(),  &mRecord.xHit);
+  mTree->Branch(c[10].c_str(), &mRecord.yHit);
+  mTree->Branch(c[11].c_str(), &mRecord.psiA);
+  mTree->Branch(c[12].c_str(), &mRecord.psiB);
+  mTree->Branch(c[13].c_str(), &mRecord.cat1);
+  mTree->Branch(c[14].c_str(), &mRecord.psi);
+  mTree->Branch(c[15].c_str(), &mRecord.phi);
+  mTree->Branch(c[16].c_str(), &mRecord.eta);
+  mTree->Branch(c[17].c_str(), &mRecord.cos);
+}
+
+TreeWriter::~TreeWriter() {
+  close();
+}
+
+void TreeWriter::fill(const HistoRecord& r) {
+  mRecord = r;
+  mTree->Fill();
+}
+
+void TreeWriter::close() {
+  if(!mFile)
+    return;
+  mFile->cd();
+  mTree->Write();
+  mFile->Close();
+  mFile.reset();
+}
+
+void TreeWriter::enable_implicit_mt(unsigned nthreads) {
+  ROOT::EnableImplicitMT(nthreads);
+}
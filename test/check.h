@@ -0,0 +1,39 @@
+#ifndef TEST_CHECK_H
+#define TEST_CHECK_H
+
+#include <cmath>
+#include <iostream>
+
+////////////////////////////////////////////
+//minimal checks for the unit tests in test/
+//Every failed check is printed with its location and counted; the main of a
+//test returns 'test::report()', which is non-zero after any failure.
+////////////////////////////////////////////
+namespace test {
+  inline unsigned failures = 0;
+  inline unsigned checks = 0;
+
+  inline bool check(bool pass, const char* expr, const char* file, int line) {
+    ++checks;
+    if(!pass) {
+      ++failures;
+      std::cerr << file << ":" << line << ": check failed: " << expr << std::endl;
+    }
+    return pass;
+  }
+
+  inline int report(const char* name) {
+    std::cout << name << ": " << checks-failures << "/" << checks << " checks passed" << std::endl;
+    return failures == 0 ? 0 : 1;
+  }
+}
+
+#define CHECK(expr) test::check(static_cast<bool>(expr), #expr, __FILE__, __LINE__)
+#define CHECK_CLOSE(a, b, tol) test::check(std::abs((a)-(b)) <= (tol), #a " == " #b, __FILE__, __LINE__)
+#define CHECK_THROWS(expr, type) do {					\
+    bool thrown = false;						\
+    try { expr; } catch(const type&) { thrown = true; }			\
+    test::check(thrown, #expr " throws " #type, __FILE__, __LINE__);	\
+  } while(false)
+
+#endif // TEST_CHECK_H
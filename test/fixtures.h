@@ -0,0 +1,42 @@
+#ifndef TEST_FIXTURES_H
+#define TEST_FIXTURES_H
+
+#include "include/geometry.h"
+#include "include/tracking.h"
+#include <cmath>
+#include <utility>
+#include <vector>
+
+////////////////////////////////////////////
+//lattice and beam particle shared by the tracking tests in test/
+//The magnets have a 20x20 cm aperture; the particle is a 200 GeV/c proton
+//starting 50 cm before the cutoff, as the beams of 'run'.
+////////////////////////////////////////////
+namespace test {
+  using XYZ = ROOT::Math::XYZVector;
+
+  inline constexpr float zcutoff = 1000.f;
+
+  inline Magnet magnet(Magnet::Type type, std::pair<double,double> intensity, double z1, double z2) {
+    return Magnet{type, "m", 0, intensity, Dimensions{-10., 10., -10., 10., z1, z2}};
+  }
+
+  //dipole and quadrupole on the negative z side
+  //(the field of a quadrupole is on between the z ends given from the larger one)
+  inline std::vector<Magnet> upstream_lattice() {
+    return { magnet(Magnet::DipoleX,    {0.5, 0.},       -900., -800.),
+	     magnet(Magnet::Quadrupole, {20.34,-20.34}, -400., -500.) };
+  }
+
+  inline Particle proton(XYZ pos = XYZ(0.3, 0.2, -zcutoff-50), XYZ mom = XYZ(0., 0., 200.)) {
+    Particle p;
+    p.pos = pos;
+    p.mom = mom;
+    p.mass = 0.938;
+    p.energy = std::sqrt(p.mom.Mag2() + p.mass*p.mass);
+    p.charge = 1;
+    return p;
+  }
+}
+
+#endif // TEST_FIXTURES_H
@@ -0,0 +1,78 @@
+#include "include/output.h"
+#include "test/check.h"
+#include <cstdio>
+#include <limits>
+#include <sstream>
+
+/*
+  CSVWriter must reproduce the bytes of the former std::to_string and
+  "%.<N>f" formatting, also when fields straddle a buffer flush.
+*/
+namespace {
+  std::string printf_fixed(double v, int precision) {
+    char buf[512];
+    std::snprintf(buf, sizeof(buf), "%.*f", precision, v);
+    return buf;
+  }
+}
+
+int main()
+{
+  const std::vector<double> doubles = {0., -0., 1., -1., 0.5, 1e-7, -1e-7, 5e-7, 123456.789012345,
+				       -3.14159265358979, 1e20, 2.5e-300, 6.02214076e23,
+				       std::numeric_limits<double>::max(), std::numeric_limits<double>::min()};
+  const std::vector<float> floats = {0.f, 1.f, -0.1f, 3.4028235e38f, 1.17549435e-38f, 7.25f, 0.3f};
+  const std::vector<long long> ints = {0, 1, -1, std::numeric_limits<long long>::max(),
+				       std::numeric_limits<long long>::min()};
+  const std::vector<unsigned> uints = {0u, 42u, std::numeric_limits<unsigned>::max()};
+
+  for(std::size_t bufferSize : {std::size_t(400), CSVWriter::mDefaultBufferSize}) {
+    std::ostringstream out;
+    std::string expected;
+    {
+      CSVWriter w(out, bufferSize);
+      w.header({"name", "value"});
+      expected += "name,value\n";
+      for(double v : doubles) {
+	w.field("d").field(v).field(v, 3).end_line();
+	expected += "d," + std::to_string(v) + "," + printf_fixed(v, 3) + "\n";
+      }
+      for(float v : floats) {
+	w.field("f").field(v).field(v, 9).end_line();
+	expected += "f," + std::to_string(v) + "," + printf_fixed(v, 9) + "\n";
+      }
+      for(long long v : ints) {
+	w.field("i").field(v).end_line();
+	expected += "i," + std::to_string(v) + "\n";
+      }
+      for(unsigned v : uints) {
+	w.field("u").field(v).end_line();
+	expected += "u," + std::to_string(v) + "\n";
+      }
+    }
+    CHECK(out.str() == expected);
+  }
+
+  /* file output through the background writer */
+  const std::string filename = "test_csvwriter.csv";
+  std::string expected;
+  {
+    CSVWriter w(filename, 32, 3);
+    for(unsigned i=0; i<1000; ++i) {
+      w.field(i).field(0.001*i).end_line();
+      expected += std::to_string(i) + "," + std::to_string(0.001*i) + "\n";
+    }
+  }
+  std::ifstream in(filename, std::ios_base::binary);
+  std::stringstream contents;
+  contents << in.rdbuf();
+  CHECK(contents.str() == expected);
+  std::remove(filename.c_str());
+
+  /* a value that cannot fit even an empty buffer is an error */
+  std::ostringstream tiny;
+  CSVWriter w(tiny, 8);
+  CHECK_THROWS(w.field(1e20), std::runtime_error);
+
+  return test::report("test_csvwriter");
+}
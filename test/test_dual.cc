@@ -0,0 +1,97 @@
+#include "include/dual.h"
+#include "include/geometry.h"
+#include "include/tracking.h"
+#include "test/check.h"
+#include "test/fixtures.h"
+#include <functional>
+#include <vector>
+
+/*
+  Every Dual operation must carry the derivatives of its result, which is
+  checked against central finite differences in two parameters, and so must a
+  computation templated on the scalar type: the Vec3 algebra and the stepping
+  of SimParticle::differentiate.
+*/
+namespace {
+  using D = Dual<2>;
+  using F = std::function<D(const D&, const D&)>;
+
+  //value and both derivatives of 'f' at (a, b) against finite differences
+  void check_derivatives(const F& f, double a, double b, double tol) {
+    const D r = f(D::variable(a, 0), D::variable(b, 1));
+    const double h = 1e-6;
+    const double da = (f(D(a+h), D(b)).v - f(D(a-h), D(b)).v) / (2*h);
+    const double db = (f(D(a), D(b+h)).v - f(D(a), D(b-h)).v) / (2*h);
+    CHECK_CLOSE(r.d[0], da, tol * (1. + std::abs(da)));
+    CHECK_CLOSE(r.d[1], db, tol * (1. + std::abs(db)));
+  }
+}
+
+int main()
+{
+  using std::sqrt;
+  const double a = 0.7, b = -1.3;
+
+  /* exact values and derivatives */
+  const D x = D::variable(a, 0), y = D::variable(b, 1);
+  const D p = x * y;
+  CHECK(p.v == a*b and p.d[0] == b and p.d[1] == a);
+  const D q = x / y;
+  CHECK_CLOSE(q.d[0], 1./b, 1e-15);
+  CHECK_CLOSE(q.d[1], -a/(b*b), 1e-15);
+  const D c(3.);
+  CHECK(c.d[0] == 0. and c.d[1] == 0.);
+  CHECK((x + 2.).d[0] == 1. and (2. - x).d[0] == -1. and (2. / x).v == 2./a);
+
+  /* every operation against finite differences */
+  const std::vector<F> functions = {
+    [](const D& u, const D& v) { return u + v; },
+    [](const D& u, const D& v) { return u - v; },
+    [](const D& u, const D& v) { return u * v; },
+    [](const D& u, const D& v) { return u / v; },
+    [](const D& u, const D& v) { return 3. * u - v / 2. + 1.; },
+    [](const D& u, const D& v) { return 2. / (u - v); },
+    [](const D& u, const D& v) { return -u * v; },
+    [](const D& u, const D& v) { D r = u; r *= v; r /= u + 2.; r += v; r -= u; return r; },
+    [](const D& u, const D& v) { return sqrt(u*u + v*v); },
+    [](const D& u, const D& v) { return abs(v) * u; },
+    [](const D& u, const D& v) { return sin(u * v); },
+    [](const D& u, const D& v) { return cos(u) * v; },
+    [](const D& u, const D& v) { return atan(u / v); },
+    [](const D& u, const D& v) { return atan2(v, u); },
+    [](const D& u, const D& v) { return atan2(-u, v); } };
+  for(const F& f : functions)
+    check_derivatives(f, a, b, 1e-7);
+
+  /* vector algebra */
+  check_derivatives([](const D& u, const D& v) {
+		      const Vec3<D> r(u, v, D(2.)), s(v*v, D(1.), u);
+		      const Vec3<D> t = r.Cross(s) * u - s / v;
+		      return t.Dot(r) + sqrt(t.Mag2());
+		    }, a, b, 1e-7);
+
+  /* comparisons only look at the values */
+  CHECK(x > y and y < x and x > 0. and y < 0. and x == a);
+
+  /* differentiated stepping against finite differences of the tracking */
+  const MagnetSystem magnets(test::upstream_lattice());
+  const tracking::TrackMode mode = tracking::TrackMode::RungeKutta4;
+  const float zcutoff = test::zcutoff;
+  const tracking::StepSettings steps = tracking::step_settings(mode, zcutoff);
+  const Particle part = test::proton();
+  const TrackGradient g = SimParticle(part, steps.nsteps, steps.stepsize).differentiate(magnets, mode, 1., zcutoff);
+  auto last = [&](double dx, double scale) {
+		Particle p = part;
+		p.pos.SetX(part.pos.X() + dx);
+		return SimParticle(p, steps.nsteps, steps.stepsize).summarize(magnets, mode, scale, zcutoff).lastPos;
+	      };
+  const double h = 1e-4;
+  const double dxdx = (last(h, 1.).X() - last(-h, 1.).X()) / (2*h);
+  const double dydscale = (last(0., 1.+h).Y() - last(0., 1.-h).Y()) / (2*h);
+  CHECK_CLOSE(g.lastPos.x.v, last(0., 1.).X(), 1e-9);
+  CHECK_CLOSE(g.lastPos.x.d[TrackGradient::X], dxdx, 1e-4 * (1. + std::abs(dxdx)));
+  CHECK_CLOSE(g.lastPos.y.d[TrackGradient::SCALE], dydscale, 1e-4 * (1. + std::abs(dydscale)));
+  CHECK(std::abs(g.lastPos.x.d[TrackGradient::X] - 1.) > 1e-3); //the field does act
+
+  return test::report("test_dual");
+}
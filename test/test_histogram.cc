@@ -0,0 +1,127 @@
+#include "include/simulation.h"
+#include "test/check.h"
+#include <numeric>
+#include <random>
+
+/*
+  Merging the histograms of shards (threads, scan configurations) must give
+  the contents of a single histogram filled with all the entries, and refuse
+  histograms with a different binning, and NaN must go to the overflow bin
+  (never into the bin computation). The cloud-in-cell filling must keep the
+  weight, match the plain filling at the bin centres and change continuously
+  with the filled value.
+*/
+namespace {
+  InputArgs histo_args() {
+    InputArgs args{};
+    args.energy = 1380.f;
+    args.npartons = 1;
+    args.histo_bins = 40;
+    args.hit_range = 5.f;
+    args.mom_range = 0.5f;
+    args.fermi_range = 0.25f;
+    return args;
+  }
+
+  HistoRecord random_record(std::mt19937& rng) {
+    std::normal_distribution<float> hit(0.f, 3.f);
+    std::uniform_real_distribution<float> angle(0.f, 2*M_PI);
+    HistoRecord r{};
+    r.sumMomX = hit(rng) / 10.;
+    r.sumMomY = hit(rng) / 10.;
+    r.fermiPzBeforeBoost = hit(rng) / 20.f;
+    r.xHit = r.xHitNoBoost = hit(rng);
+    r.yHit = r.yHitNoBoost = hit(rng);
+    r.psiA = angle(rng);
+    r.psiB = angle(rng);
+    r.cat1 = rng() % 3;
+    return r;
+  }
+}
+
+int main()
+{
+  /* 1D and 2D histograms: two shards merged equal one histogram */
+  Histo1D all("h", 10, -1., 1.), a("h", 10, -1., 1.), b("h", 10, -1., 1.);
+  Histo2D all2("h2", 4, 0., 1., 3, -1., 1.), a2("h2", 4, 0., 1., 3, -1., 1.), b2("h2", 4, 0., 1., 3, -1., 1.);
+  std::mt19937 rng(1);
+  std::normal_distribution<double> x(0., 0.7);
+  for(unsigned i=0; i<1000; ++i) {
+    const double v = x(rng), w = x(rng);
+    all.fill(v);
+    all2.fill(w, v);
+    (i%2 ? a : b).fill(v);
+    (i%3 ? a2 : b2).fill(w, v);
+  }
+  a.merge(b);
+  a2.merge(b2);
+  CHECK(a.contents() == all.contents());
+  CHECK(a2.contents() == all2.contents());
+  CHECK(all.content(0) > 0. and all.content(11) > 0.); //under/overflows are merged too
+
+  CHECK_THROWS(a.merge(Histo1D("h", 10, -1., 2.)), std::invalid_argument);
+  CHECK_THROWS(a.merge(Histo1D("h", 11, -1., 1.)), std::invalid_argument);
+  CHECK_THROWS(a2.merge(Histo2D("h2", 4, 0., 1., 4, -1., 1.)), std::invalid_argument);
+
+  /* NaN is an overflow */
+  Histo1D nan("n", 10, -1., 1.);
+  nan.fill(std::nan(""));
+  CHECK(nan.content(11) == 1. and std::accumulate(nan.contents().begin(), nan.contents().end(), 0.) == 1.);
+  Histo2D nan2("n2", 4, 0., 1., 3, -1., 1.);
+  nan2.fill(std::nan(""), 0.);
+  nan2.fill(0.5, std::nan(""));
+  CHECK(nan2.content(5, 2) == 1. and nan2.content(3, 4) == 1.);
+
+  /* cloud-in-cell filling */
+  Histo1D centre("c", 10, -1., 1.), hard("c", 10, -1., 1.);
+  centre.fill_smooth(-0.5);
+  hard.fill(-0.5);
+  CHECK(centre.contents() == hard.contents()); //-0.5 is the centre of bin 3
+  Histo1D left("s", 10, -1., 1.), right("s", 10, -1., 1.);
+  left.fill_smooth(0.14, 2.);
+  right.fill_smooth(0.141, 2.);
+  CHECK_CLOSE(left.content(6), 2. * 0.8, 1e-12); //0.14 is 0.2 bins above the centre of bin 6
+  CHECK_CLOSE(left.content(7), 2. * 0.2, 1e-12);
+  double change = 0.;
+  for(unsigned bin=0; bin<12; ++bin)
+    change += std::abs(left.content(bin) - right.content(bin));
+  CHECK_CLOSE(change, 2. * 2. * 0.001 / 0.2, 1e-9); //continuous: proportional to the shift
+  Histo1D edges("e", 10, -1., 1.);
+  edges.fill_smooth(-5.);
+  edges.fill_smooth(5.);
+  edges.fill_smooth(std::nan(""));
+  CHECK(edges.content(0) == 1. and edges.content(11) == 2.);
+  Histo2D smooth2("s2", 4, 0., 1., 3, -1., 1.);
+  smooth2.fill_smooth(0.4, 0.1, 3.);
+  const double total2 = std::accumulate(smooth2.contents().begin(), smooth2.contents().end(), 0.);
+  CHECK_CLOSE(total2, 3., 1e-12);
+  CHECK_CLOSE(smooth2.content(2, 2) + smooth2.content(2, 3), 3. * 0.9, 1e-12); //0.4 is 0.1 bins below the centre of bin 2
+
+  /* V1Histograms with the ranges of the options */
+  const InputArgs args = histo_args();
+  V1Histograms vall(args), va(args), vb(args);
+  for(unsigned i=0; i<2000; ++i) {
+    HistoRecord r = random_record(rng);
+    vall.fill(r);
+    (i%2 ? va : vb).fill(r);
+  }
+  va.merge(vb);
+  for(const std::string name : {"XHit", "sumMomX", "FermiPzBeforeBoost", "PsiA_PsiB", "XHit_YHit", "cat1"})
+    CHECK(va.contents(name) == vall.contents(name));
+  CHECK(vall.xHit.axis().nbins() == args.histo_bins);
+  CHECK(vall.xHit.axis().low_edge(1) == -args.hit_range);
+  CHECK(vall.sumMomX.axis().high_edge(args.histo_bins) == args.mom_range);
+
+  V1Histograms vsmooth(args, true);
+  for(unsigned i=0; i<100; ++i)
+    vsmooth.fill(random_record(rng));
+  const Vec<double> xs = vsmooth.contents("XHit");
+  CHECK_CLOSE(std::accumulate(xs.begin(), xs.end(), 0.), 100., 1e-9);
+  CHECK(std::any_of(xs.begin(), xs.end(), [](double c) { return c != std::floor(c); }));
+
+  InputArgs wide = args;
+  wide.hit_range = 20.f;
+  CHECK_THROWS(va.merge(V1Histograms(wide)), std::invalid_argument);
+
+  return test::report("test_histogram");
+}
@@ -0,0 +1,72 @@
+#include "test/check.h"
+#include "test/fixtures.h"
+#include <vector>
+
+/*
+  In a lattice that MagnetSystem::mirror_symmetric accepts, the field must
+  reflect under z -> -z and the track of a reflected particle must be the
+  reflection of the track (what '--fastsim' relies on to answer beam 2 with the
+  table of beam 1); a lattice without a mirrored partner must be rejected.
+*/
+namespace {
+  using test::XYZ;
+  using test::magnet;
+
+  double distance(const XYZ& a, const XYZ& b) { return std::sqrt((a - b).Mag2()); }
+}
+
+int main()
+{
+  //the upstream lattice, its mirror image and a magnet that is its own partner
+  const std::vector<Magnet> upstream = test::upstream_lattice();
+  const std::vector<Magnet> symmetric = {
+    upstream[0],
+    magnet(Magnet::DipoleX,    {-0.5, 0.},       800.,  900.),
+    magnet(Magnet::DipoleY,    {0., -1.2},      -700., -600.),
+    magnet(Magnet::DipoleY,    {0., -1.2},       600.,  700.),
+    upstream[1],
+    magnet(Magnet::Quadrupole, {20.34,-20.34},  500.,  400.),
+    magnet(Magnet::DipoleY,    {0., 0.8},       -50.,   50.) };
+  const MagnetSystem magnets(symmetric);
+  CHECK(magnets.mirror_symmetric());
+
+  /* a missing partner or a partner with the field that does not reflect */
+  std::vector<Magnet> lattice = symmetric;
+  lattice.erase(lattice.begin() + 3);
+  CHECK(!MagnetSystem(lattice).mirror_symmetric());
+  lattice = symmetric;
+  lattice[1].intensity.first = 0.5;
+  CHECK(!MagnetSystem(lattice).mirror_symmetric());
+  lattice = symmetric;
+  lattice[5].dims = Dimensions{-10., 10., -10., 10., 500., 410.};
+  CHECK(!MagnetSystem(lattice).mirror_symmetric());
+
+  /* field at (x, y, -z) is (-Bx, -By, Bz) at (x, y, z) */
+  for(const XYZ& pos : {XYZ(0.3, -0.2, 850.), XYZ(-1., 0.5, 650.), XYZ(2., 1., 450.), XYZ(0.1, 0.1, 20.)}) {
+    const XYZ b = magnets.field(pos, 1.);
+    const XYZ m = magnets.field(XYZ(pos.X(), pos.Y(), -pos.Z()), 1.);
+    CHECK(b.Mag2() > 0.);
+    CHECK(distance(m, XYZ(-b.X(), -b.Y(), b.Z())) <= 1e-12 * std::sqrt(b.Mag2()));
+  }
+
+  /* mirror_z is an involution */
+  //towards the axis, as the beams (Euler stops once |x| or |y| grows)
+  const Particle p = test::proton(XYZ(0.2, -0.1, test::zcutoff+50), XYZ(-1e-4, 5e-5, -200.));
+  CHECK(mirror_z(mirror_z(p)).pos == p.pos and mirror_z(mirror_z(p)).mom == p.mom);
+
+  /* the track of the reflected particle is the reflected track, in both modes */
+  const float zcutoff = test::zcutoff;
+  for(tracking::TrackMode mode : {tracking::TrackMode::Euler, tracking::TrackMode::RungeKutta4}) {
+    const tracking::StepSettings steps = tracking::step_settings(mode, zcutoff);
+    const TrackSummary direct = SimParticle(p, steps.nsteps, steps.stepsize).summarize(magnets, mode, 1., zcutoff);
+    const TrackSummary mirrored = mirror_z(SimParticle(mirror_z(p), steps.nsteps, steps.stepsize).summarize(magnets, mode, 1., zcutoff));
+    CHECK(direct.nStepsUsed == mirrored.nStepsUsed);
+    CHECK(distance(direct.lastPos, mirrored.lastPos) < 1e-9);
+    CHECK(distance(direct.lastMom, mirrored.lastMom) < 1e-9);
+    CHECK(distance(direct.closest.pos, mirrored.closest.pos) < 1e-9);
+    CHECK_CLOSE(direct.closest.distance, mirrored.closest.distance, 1e-9);
+    CHECK(distance(direct.lastPos, p.pos) > 1.); //it did move
+  }
+
+  return test::report("test_mirror");
+}
@@ -0,0 +1,58 @@
+#include "include/moments.h"
+#include "test/check.h"
+#include "test/fixtures.h"
+#include <random>
+#include <vector>
+
+/*
+  The transported moments of a beam must agree with those of 400 sampled
+  tracks of the same beam: the means within three standard errors, the widths
+  within three sampling errors of a standard deviation (sigma / sqrt(2n)).
+  Only Runge-Kutta tracks are compared: an Euler track stops as soon as it
+  moves away from the axis, so its outcomes are not smooth across the beam.
+*/
+int main()
+{
+  using test::zcutoff;
+  std::vector<Magnet> lattice = test::upstream_lattice();
+  lattice.push_back(test::magnet(Magnet::DipoleY, {0., -1.2}, -300., -200.));
+  const MagnetSystem magnets(lattice);
+  const double sigma = 0.1;
+  const unsigned nsamples = 400;
+
+  const Particle beam = test::proton();
+
+  BeamTransport::Sigma cov;
+  cov(0,0) = cov(1,1) = sigma*sigma;
+
+  const tracking::TrackMode mode = tracking::TrackMode::RungeKutta4;
+  const tracking::StepSettings steps = tracking::step_settings(mode, zcutoff);
+  const BeamTransport transport(magnets, mode, steps.nsteps, steps.stepsize, 1., zcutoff);
+  const BeamTransport::Moments m = transport.transport(beam, cov, 1e-2 * sigma);
+
+  /* sampled beam */
+  std::mt19937 rng(2024);
+  std::normal_distribution<double> spread(0., sigma);
+  std::vector<double> sum(BeamTransport::NOUT, 0.), sum2(BeamTransport::NOUT, 0.);
+  for(unsigned i=0; i<nsamples; ++i) {
+    Particle p = beam;
+    p.pos.SetX(beam.pos.X() + spread(rng));
+    p.pos.SetY(beam.pos.Y() + spread(rng));
+    const BeamTransport::Outcomes o = transport.outcomes(p);
+    for(unsigned k=0; k<BeamTransport::NOUT; ++k) {
+      sum[k] += o[k];
+      sum2[k] += o[k]*o[k];
+    }
+  }
+
+  for(unsigned k : {BeamTransport::DirX, BeamTransport::DirY, BeamTransport::MomX, BeamTransport::MomY}) {
+    const double mean = sum[k] / nsamples;
+    const double width = std::sqrt(std::max(0., sum2[k] / nsamples - mean*mean));
+    const double transported = std::sqrt(m.cov(k,k));
+    CHECK(width > 0.);
+    CHECK_CLOSE(m.mean[k], mean, 3 * width / std::sqrt(nsamples));
+    CHECK_CLOSE(transported, width, 3 * width / std::sqrt(2. * nsamples));
+  }
+
+  return test::report("test_moments");
+}
@@ -0,0 +1,88 @@
+#include "include/pipeline.h"
+#include "test/check.h"
+#include <chrono>
+#include <numeric>
+#include <stdexcept>
+
+/*
+  The SPSC queue must hand over every item exactly once and in order, also
+  when one side sleeps, and the pipeline must rethrow the first exception of
+  any stage after every thread has finished.
+*/
+int main()
+{
+  /* capacity */
+  SPSCQueue<int> q(3);
+  CHECK(q.try_push(1) and q.try_push(2) and q.try_push(3));
+  CHECK(!q.try_push(4));
+  int v = 0;
+  CHECK(q.try_pop(v) and v == 1);
+  CHECK(q.try_push(4));
+  CHECK(q.pop() == 2 and q.pop() == 3 and q.pop() == 4);
+  CHECK(!q.try_pop(v));
+
+  /* ordered hand-over between two threads through a small queue */
+  const unsigned n = 200000;
+  SPSCQueue<unsigned> small(2);
+  std::thread producer([&] {
+			 for(unsigned i=1; i<=n; ++i)
+			   small.push(i);
+			 small.push(0);
+		       });
+  unsigned expected = 1, received = 0;
+  bool ordered = true;
+  while(unsigned i = small.pop()) {
+    ordered = ordered and i == expected++;
+    ++received;
+  }
+  producer.join();
+  CHECK(ordered);
+  CHECK(received == n);
+
+  /* a consumer that sleeps is woken up by a late producer */
+  SPSCQueue<unsigned> late(1);
+  std::thread sleeper([&] {
+			std::this_thread::sleep_for(std::chrono::milliseconds(50));
+			late.push(7);
+		      });
+  CHECK(late.pop() == 7);
+  sleeper.join();
+
+  /* pipeline: every item goes through every stage in order */
+  std::vector<std::vector<unsigned>> pool(3);
+  unsigned next = 0;
+  std::vector<unsigned> out;
+  Pipeline<std::vector<unsigned>> ok([&](std::vector<unsigned>& item) {
+				       if(next == 1000)
+					 return false;
+				       item.assign(1, next++);
+				       return true;
+				     },
+				     {[](std::vector<unsigned>& item) { item.push_back(item[0]*2); },
+				      [](std::vector<unsigned>& item) { item.push_back(item[1]+1); }},
+				     [&](std::vector<unsigned>& item) { out.push_back(item[2]); });
+  ok.run(pool);
+  bool stages = out.size() == 1000;
+  for(unsigned i=0; stages and i<out.size(); ++i)
+    stages = out[i] == 2*i+1;
+  CHECK(stages);
+
+  /* a failing stage stops the pipeline and its exception reaches 'run' */
+  next = 0;
+  unsigned sunk = 0;
+  Pipeline<std::vector<unsigned>> failing([&](std::vector<unsigned>& item) {
+					    if(next == 1000)
+					      return false;
+					    item.assign(1, next++);
+					    return true;
+					  },
+					  {[](std::vector<unsigned>& item) {
+					     if(item[0] == 10)
+					       throw std::runtime_error("stage failure");
+					   }},
+					  [&](std::vector<unsigned>&) { ++sunk; });
+  CHECK_THROWS(failing.run(pool), std::runtime_error);
+  CHECK(sunk <= 10);
+
+  return test::report("test_pipeline");
+}
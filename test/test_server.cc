@@ -0,0 +1,92 @@
+#include "include/server.h"
+#include "test/check.h"
+#include <chrono>
+#include <cstring>
+#include <fstream>
+#include <sstream>
+#include <stdexcept>
+
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+/*
+  The server must replace a socket left by a previous one but never another
+  file, and a client that connects without sending anything must not hold
+  the connection beyond the timeout. A request that cannot be run must be
+  answered with a single error line, before any context is built for it.
+*/
+namespace {
+  sockaddr_un address(const std::string& path) {
+    sockaddr_un addr{};
+    addr.sun_family = AF_UNIX;
+    std::strncpy(addr.sun_path, path.c_str(), sizeof(addr.sun_path) - 1);
+    return addr;
+  }
+
+  bool exists(const std::string& path) {
+    struct stat st;
+    return ::lstat(path.c_str(), &st) == 0;
+  }
+}
+
+int main()
+{
+  const std::string path = "/tmp/test_server_" + std::to_string(::getpid()) + ".sock";
+
+  /* another file at the path is left alone */
+  std::ofstream(path) << "data\n";
+  CHECK_THROWS(UnixServer server(path), std::invalid_argument);
+  CHECK(exists(path));
+  ::unlink(path.c_str());
+
+  /* a stale socket (its server is gone without removing it) is replaced */
+  const int stale = ::socket(AF_UNIX, SOCK_STREAM, 0);
+  const sockaddr_un addr = address(path);
+  CHECK(::bind(stale, reinterpret_cast<const sockaddr*>(&addr), sizeof(addr)) == 0);
+  ::close(stale);
+  CHECK(exists(path));
+  {
+    UnixServer server(path);
+
+    /* a silent client is dropped after the timeout */
+    const int client = ::socket(AF_UNIX, SOCK_STREAM, 0);
+    CHECK(::connect(client, reinterpret_cast<const sockaddr*>(&addr), sizeof(addr)) == 0);
+    const auto start = std::chrono::steady_clock::now();
+    SocketStream conn(server.accept(0.2));
+    std::string line;
+    CHECK(!std::getline(conn, line));
+    const std::chrono::duration<double> waited = std::chrono::steady_clock::now() - start;
+    CHECK(waited.count() > 0.1 and waited.count() < 5.);
+
+    /* a client that sends its line is served */
+    const int talker = ::socket(AF_UNIX, SOCK_STREAM, 0);
+    CHECK(::connect(talker, reinterpret_cast<const sockaddr*>(&addr), sizeof(addr)) == 0);
+    CHECK(::send(talker, "--x 0.1\n", 8, 0) == 8);
+    SocketStream conn2(server.accept(0.2));
+    CHECK(std::getline(conn2, line) and line == "--x 0.1");
+    ::close(client);
+    ::close(talker);
+  }
+  CHECK(!exists(path)); //removed with the server
+
+  /* rejected requests */
+  const po::options_description desc = run_options();
+  bool looked_up = false;
+  const ContextLookup context = [&](const InputArgs&) -> const SharedContext& {
+				  looked_up = true;
+				  throw std::logic_error("no context in this test");
+				};
+  for(const std::string request : {"--x 0.1 --draw", "--x 0.1 --scan x=0,1", "--x 0.1 --output root", "--x 0.1 --unknown 1"}) {
+    std::ostringstream answer;
+    const std::string status = serve_request(request, answer, 3, desc, 2, context);
+    CHECK(status.rfind("error: ", 0) == 0 and answer.str() == status + "\n");
+  }
+  CHECK(!looked_up);
+  std::ostringstream answer;
+  CHECK(serve_request("--x 0.1 --y 0.1 --energy 1380", answer, 4, desc, 2, context) == "error: no context in this test");
+  CHECK(looked_up and answer.str() == "error: no context in this test\n");
+
+  return test::report("test_server");
+}
@@ -0,0 +1,79 @@
+#include "include/summarycache.h"
+#include "test/check.h"
+#include <thread>
+#include <vector>
+
+/*
+  A particle must be tracked once however many runs ask for it, also when they
+  ask at the same time, and the least recently used summaries must make room
+  for new ones once the cache is full.
+*/
+namespace {
+  Particle particle(double x) {
+    Particle p;
+    p.pos = ROOT::Math::XYZVector(x, 0., -150.);
+    p.mom = ROOT::Math::XYZVector(0., 0., 100.);
+    p.energy = 100.;
+    p.mass = 0.938;
+    p.charge = 1;
+    return p;
+  }
+
+  bool same(const TrackSummary& a, const TrackSummary& b) {
+    return a.nStepsUsed == b.nStepsUsed and a.lastPos == b.lastPos and a.lastMom == b.lastMom
+      and a.closest.pos == b.closest.pos and a.closest.distance == b.closest.distance;
+  }
+}
+
+int main()
+{
+  const MagnetSystem magnets(std::vector<Magnet>{}); //field free: straight lines
+  const tracking::TrackMode mode = tracking::TrackMode::Euler;
+  const auto simp = [](double x) { return SimParticle(particle(x), 400, 1.); };
+  const TrackSummary exact = simp(0.1).summarize(magnets, mode, 1., 100.f);
+
+  /* hits and misses */
+  SummaryCache cache(magnets, 2);
+  CHECK(same(cache.summarize(simp(0.1), mode, 1., 100.f), exact));
+  CHECK(same(cache.summarize(simp(0.1), mode, 1., 100.f), exact));
+  CHECK(cache.misses() == 1 and cache.hits() == 1);
+  cache.summarize(simp(0.1), mode, 1., 50.f); //other tracking inputs
+  CHECK(cache.misses() == 2 and cache.size() == 2);
+
+  /* without field a scaled momentum reuses the track, with the momenta scaled */
+  Particle fast = particle(0.1);
+  fast.mom *= 2.;
+  const TrackSummary scaled = cache.summarize(SimParticle(fast, 400, 1.), mode, 1., 100.f);
+  CHECK(cache.hits() == 2);
+  CHECK_CLOSE(scaled.lastMom.Z(), 2. * exact.lastMom.Z(), 1e-9);
+  CHECK(scaled.lastPos == exact.lastPos);
+
+  /* least recently used eviction: x=0.1 (just used) stays, zcutoff 50 goes */
+  cache.summarize(simp(0.2), mode, 1., 100.f);
+  CHECK(cache.size() == 2 and cache.misses() == 3);
+  cache.summarize(simp(0.1), mode, 1., 100.f);
+  CHECK(cache.hits() == 3);
+  cache.summarize(simp(0.1), mode, 1., 50.f);
+  CHECK(cache.misses() == 4 and cache.size() == 2);
+
+  /* concurrent requests of the same particle track it once */
+  SummaryCache shared(magnets, 16);
+  const unsigned nthreads = 8;
+  std::vector<TrackSummary> results(nthreads);
+  std::vector<std::thread> threads;
+  for(unsigned t=0; t<nthreads; ++t)
+    threads.emplace_back([&, t] { results[t] = shared.summarize(simp(0.3), mode, 1., 100.f); });
+  for(std::thread& t : threads)
+    t.join();
+  CHECK(shared.misses() == 1 and shared.hits() == nthreads-1);
+  for(const TrackSummary& r : results)
+    CHECK(same(r, results[0]));
+
+  /* no capacity: nothing is kept */
+  SummaryCache none(magnets, 0);
+  none.summarize(simp(0.1), mode, 1., 100.f);
+  none.summarize(simp(0.1), mode, 1., 100.f);
+  CHECK(none.misses() == 2 and none.size() == 0);
+
+  return test::report("test_summarycache");
+}